@@ -3,6 +3,15 @@
 //
 
 #pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
 
 class AssetServer {
 public:
@@ -12,9 +21,211 @@ public:
         Resource() = default;
         Resource (std::string_view content, std::string mimeType);
 
-        std::vector<uint8_t> data;
+        // A view of the resource bytes. It points either at static data (e.g. BinaryData)
+        // or into `owner`, which keeps shared immutable storage alive for as long as any
+        // copy of the Resource does, so resources can be passed around without copying.
+        std::span<const uint8_t> data;
+        std::shared_ptr<const void> owner;
         std::string mimeType;
+
+        // Content-Encoding of `data` ("br", "gzip", "deflate"), empty for identity
+        std::string contentEncoding;
+
+        // HTTP cache validators. `etag` is a quoted entity tag; notModified is set
+        // (with empty data) when the request's If-None-Match already matches it.
+        std::string etag;
+        std::string cacheControl;
+        bool notModified {false};
+
+        // Set when `data` is a byte window of a larger body (206 Partial Content).
+        // rangeNotSatisfiable means the requested range was outside the body (416).
+        bool partial {false};
+        bool rangeNotSatisfiable {false};
+        size_t rangeStart {0};
+        size_t totalSize {0};
+
+        // Value for a Content-Range header, for partial or unsatisfiable responses
+        std::string getContentRange() const {
+            if (rangeNotSatisfiable) return "bytes */" + std::to_string(totalSize);
+            return "bytes " + std::to_string(rangeStart) + "-"
+                   + std::to_string(rangeStart + data.size() - 1) + "/" + std::to_string(totalSize);
+        }
     };
+
+    // Request details a transport can pass along when it has them (e.g. from HTTP headers)
+    struct Request
+    {
+        std::string_view path;
+        std::string_view acceptEncoding;
+        std::string_view ifNoneMatch;
+        std::string_view range;
+    };
+
+    virtual ~AssetServer() = default;
+
     virtual std::optional<Resource> getResource(
             std::string_view p) = 0;
+
+    // Servers that can do better than the plain path lookup (e.g. serve an encoded
+    // variant) override this; the default ignores everything but the path.
+    virtual std::optional<Resource> getResource(const Request& request) {
+        return getResource(request.path);
+    }
+
+    // True if an Accept-Encoding header value allows `encoding`. An entry naming the
+    // encoding takes precedence over "*", and a q=0 weight on either refuses it.
+    static bool acceptsEncoding(std::string_view acceptEncoding, std::string_view encoding) {
+        std::optional<bool> named, wildcard;
+        while (!acceptEncoding.empty()) {
+            auto comma = acceptEncoding.find(',');
+            auto entry = acceptEncoding.substr(0, comma);
+            acceptEncoding = comma == std::string_view::npos ? std::string_view{} : acceptEncoding.substr(comma + 1);
+
+            auto semicolon = entry.find(';');
+            auto name = trim(entry.substr(0, semicolon));
+            auto accepted = semicolon == std::string_view::npos || !hasZeroWeight(entry.substr(semicolon + 1));
+
+            if (equalsIgnoringCase(name, encoding)) named = accepted;
+            else if (name == "*") wildcard = accepted;
+        }
+        return named.value_or(wildcard.value_or(false));
+    }
+
+    // Strong entity tag from a content hash (64-bit FNV-1a)
+    static std::string makeETag(std::span<const uint8_t> data) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (auto byte : data) {
+            hash = (hash ^ byte) * 0x100000001b3ull;
+        }
+
+        static constexpr char hex[] = "0123456789abcdef";
+        std::string etag(18, '"');
+        for (int i = 0; i < 16; i++) {
+            etag[16 - i] = hex[(hash >> (i * 4)) & 0xf];
+        }
+        return etag;
+    }
+
+    // Weak comparison of an If-None-Match header value against an entity tag
+    static bool etagMatches(std::string_view ifNoneMatch, std::string_view etag) {
+        if (etag.empty()) return false;
+        if (etag.starts_with("W/")) etag.remove_prefix(2);
+
+        while (!ifNoneMatch.empty()) {
+            auto comma = ifNoneMatch.find(',');
+            auto candidate = trim(ifNoneMatch.substr(0, comma));
+            ifNoneMatch = comma == std::string_view::npos ? std::string_view{} : ifNoneMatch.substr(comma + 1);
+
+            if (candidate == "*") return true;
+            if (candidate.starts_with("W/")) candidate.remove_prefix(2);
+            if (candidate == etag) return true;
+        }
+        return false;
+    }
+
+    // Bundlers put a content hash in output names (index-BxYz12Ab.js, app.3f9a1c2b.css).
+    // Those never change content under the same name, so they can be cached forever.
+    static bool isHashedFilename(std::string_view path) {
+        auto name = path.substr(path.find_last_of('/') + 1);
+        auto extension = name.find_last_of('.');
+        if (extension == std::string_view::npos) return false;
+        name = name.substr(0, extension);
+
+        auto separator = name.find_last_of("-.");
+        if (separator == std::string_view::npos) return false;
+        auto hash = name.substr(separator + 1);
+        if (hash.size() < 8) return false;
+
+        bool hasDigit = false;
+        for (auto c : hash) {
+            if (c >= '0' && c <= '9') hasDigit = true;
+            else if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_')) return false;
+        }
+        return hasDigit;
+    }
+
+    // Narrows a resource to the window asked for by a Range header. Only single
+    // "bytes=" ranges are handled. Anything else, including a malformed range like
+    // bytes=5-3, is ignored and leaves the full body (RFC 9110 14.2); only a valid
+    // range that starts past the end of the body is unsatisfiable (416).
+    // Since data is a view this never copies, and with a mapped file only the pages
+    // inside the window are ever read from disk.
+    static void applyRange(Resource& resource, std::string_view rangeHeader) {
+        resource.totalSize = resource.data.size();
+        rangeHeader = trim(rangeHeader);
+        if (!rangeHeader.starts_with("bytes=")) return;
+        rangeHeader.remove_prefix(6);
+        if (rangeHeader.find(',') != std::string_view::npos) return;
+
+        auto dash = rangeHeader.find('-');
+        if (dash == std::string_view::npos) return;
+
+        std::optional<size_t> first, last;
+        if (!parseSize(trim(rangeHeader.substr(0, dash)), first)
+            || !parseSize(trim(rangeHeader.substr(dash + 1)), last)
+            || (!first && !last)
+            || (first && last && *last < *first)) {
+            return;
+        }
+
+        const auto total = resource.data.size();
+        // suffix range: the last N bytes, or the whole body if it's shorter than N
+        const auto start = first ? *first : total - std::min(*last, total);
+
+        if (start >= total) {
+            resource.rangeNotSatisfiable = true;
+            resource.data = {};
+            return;
+        }
+
+        const auto end = first && last ? std::min(*last, total - 1) + 1 : total;
+        resource.data = resource.data.subspan(start, end - start);
+        resource.rangeStart = start;
+        resource.partial = true;
+    }
+
+    static constexpr const char* immutableCacheControl = "public, max-age=31536000, immutable";
+    static constexpr const char* revalidateCacheControl = "no-cache";
+
+private:
+    // Empty input parses as nullopt; returns false on anything that isn't digits.
+    // Values too big for size_t saturate rather than wrap: they're past the end of
+    // any body either way, and the range checks clamp them to its size.
+    static bool parseSize(std::string_view s, std::optional<size_t>& out) {
+        if (s.empty()) return true;
+        constexpr auto maxSize = std::numeric_limits<size_t>::max();
+        size_t v = 0;
+        for (auto c : s) {
+            if (c < '0' || c > '9') return false;
+            const auto digit = static_cast<size_t>(c - '0');
+            v = v > (maxSize - digit) / 10 ? maxSize : v * 10 + digit;
+        }
+        out = v;
+        return true;
+    }
+
+    // True for a "q=0" (or "q=0.000") parameter in an Accept-Encoding entry
+    static bool hasZeroWeight(std::string_view params) {
+        while (!params.empty()) {
+            auto semicolon = params.find(';');
+            auto param = trim(params.substr(0, semicolon));
+            params = semicolon == std::string_view::npos ? std::string_view{} : params.substr(semicolon + 1);
+
+            if (param.size() < 3 || (param[0] != 'q' && param[0] != 'Q') || param[1] != '=') continue;
+            return param.substr(2).find_first_not_of("0.") == std::string_view::npos;
+        }
+        return false;
+    }
+
+    static bool equalsIgnoringCase(std::string_view a, std::string_view b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) {
+            return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+        });
+    }
+
+    static std::string_view trim(std::string_view s) {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+        return s;
+    }
 };
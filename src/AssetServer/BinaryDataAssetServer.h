@@ -5,9 +5,13 @@
 #pragma once
 
 // #include "choc/gui/choc_WebView.h"
+#include <list>
+#include <mutex>
+#include <unordered_map>
 #include <utility>
 #include "AssetServer.h"
 #include <imagiro_processor/config/Resources.h>
+#include "imagiro_util/miniz/compress_string.h"
 
 // using choc::ui::WebView;
 using GetResourceFn = std::function<const char*(const char*, int&)>;
@@ -24,56 +28,56 @@ namespace imagiro {
         virtual ~BinaryDataAssetServer() = default;
 
         std::optional<Resource> getResource(std::string_view path) override {
-            //            if (p.starts_with("http")) {
-            //                return getWebResource(juce::URL(p));
-            //            }
+            return resolveResource(path, false);
+        }
 
-            if (path == "/") {
-                path = "index.html";
-            }
+        // Serves a precompressed variant when the client accepts one, an empty
+        // notModified resource when If-None-Match matches what the client already has,
+        // and only the requested window for Range requests.
+        std::optional<Resource> getResource(const Request& request) override {
+            auto resource = getEncodedResource(request);
+            if (!resource) return resource;
 
-            if (path.starts_with("/$RES/")) {
-                auto relPath = juce::String(std::string (path)).replace("/$RES/", "");
-
-#if JUCE_DEBUG && defined(SRCPATH)
-                auto file = juce::File(juce::String(SRCPATH) + "/../resources/system/resources")
-                        .getChildFile(relPath);
-#else
-                auto file = Resources::getSystemDataFolder().getChildFile("resources")
-                                                                 .getChildFile(relPath);
-#endif
-                if (!file.exists()) {
-                    return {};
-                }
+            if (etagMatches(request.ifNoneMatch, resource->etag)) {
+                resource->data = {};
+                resource->owner.reset();
+                resource->notModified = true;
+                return resource;
+            }
 
-                juce::MemoryBlock fileData;
-                file.loadFileAsData(fileData);
+            applyRange(*resource, request.range);
+            return resource;
+        }
 
-                return toResource(static_cast<char*>(fileData.getData()),
-                                  file.getSize(),
-                                  getMimeType(file.getFileExtension().toStdString()));
+        // Build-time variants are embedded next to the asset (app.js.br / app.js.gz);
+        // otherwise compressible assets are deflated once on first request and cached.
+        std::optional<Resource> getEncodedResource(const Request& request) {
+            auto resource = resolveResource(request.path, true);
+            if (!resource || request.acceptEncoding.empty() || request.path.starts_with("/$RES/")) {
+                return resource;
             }
 
-            auto resourceName = juce::String(std::string(path))
-                    .replace(".", "_")
-                    .replace("-", "").toStdString();
-
-            resourceName = resourceName.substr(resourceName.find_last_of('/') + 1);
-            if (isdigit(resourceName[0])) resourceName = "_" + resourceName;
+            const auto& variants = getEncodedVariants(request.path == "/" ? "index.html" : request.path,
+                                                      resource->mimeType);
 
-            int resourceSize = 0;
-            const auto resource = getNamedResource(resourceName.c_str(), resourceSize);
-            if (!resource) {
-                jassert(resourceName == "favicon_ico" || resourceName == "index_html"); // probably an error if theres something that isnt the favicon we cant find
-                return {};
-            }
+            auto withEncoding = [&](const char* data, size_t size, const char* encoding,
+                                    std::shared_ptr<const void> owner = {}) {
+                auto r = toResource(data, size, resource->mimeType, std::move(owner));
+                r.contentEncoding = encoding;
+                // Each representation needs its own tag, so key it off the identity hash
+                r.etag = resource->etag.substr(0, resource->etag.size() - 1) + "-" + encoding + "\"";
+                r.cacheControl = resource->cacheControl;
+                return r;
+            };
 
-            const auto filePath = std::string(getNamedResourceOriginalFilename(
-                    resourceName.c_str()));
+            if (variants.br && acceptsEncoding(request.acceptEncoding, "br"))
+                return withEncoding(variants.br->data, variants.br->size, "br");
+            if (variants.gzip && acceptsEncoding(request.acceptEncoding, "gzip"))
+                return withEncoding(variants.gzip->data, variants.gzip->size, "gzip");
+            if (variants.deflate && acceptsEncoding(request.acceptEncoding, "deflate"))
+                return withEncoding(variants.deflate->data(), variants.deflate->size(), "deflate", variants.deflate);
 
-            const auto fileExtension = filePath.substr(filePath.find_last_of('.') + 1);
-            return toResource(resource, resourceSize,
-                              getMimeType(fileExtension));
+            return resource;
         }
         //
         //        std::optional<WebView::Options::Resource> getWebResource(juce::URL url) {
@@ -114,14 +118,35 @@ namespace imagiro {
             return "application/octet-stream";
         }
 
-        static Resource toResource(const char* data, unsigned int size, const std::string& mimeType) {
-            std::vector<uint8_t> d;
-            std::string contentRange;
+        // Upper bound on bytes kept in memory by the /$RES/ cache. Entries still in use
+        // by a served Resource stay valid after eviction; they're just no longer cached.
+        void setFileCacheBudget(size_t bytes) {
+            std::lock_guard l(fileCacheLock);
+            fileCacheBudget = bytes;
+            trimFileCache();
+        }
 
-            d.assign(reinterpret_cast<const uint8_t*>(&data[0]), reinterpret_cast<const uint8_t*>(&data[size]));
+        // Files at least this big are memory mapped per request instead of read and
+        // cached. See getFileResource() for why mappings aren't kept.
+        void setFileMapThreshold(size_t bytes) {
+            std::lock_guard l(fileCacheLock);
+            fileMapThreshold = bytes;
+        }
 
+        // Formats that are already compressed gain nothing from another pass
+        static bool isCompressible(std::string_view mimeType) {
+            return mimeType.starts_with("text/")
+                   || mimeType == "image/svg+xml"
+                   || mimeType == "application/wasm"
+                   || mimeType == "font/ttf";
+        }
+
+        // Wraps data without copying it. Pass an owner unless data is static.
+        static Resource toResource(const char* data, size_t size, const std::string& mimeType,
+                                   std::shared_ptr<const void> owner = {}) {
             Resource r;
-            r.data = d;
+            r.data = {reinterpret_cast<const uint8_t*>(data), size};
+            r.owner = std::move(owner);
             r.mimeType = mimeType;
             return r;
         }
@@ -129,6 +154,250 @@ namespace imagiro {
     private:
         GetResourceFn getNamedResource;
         GetResourceOriginalFilenameFn getNamedResourceOriginalFilename;
+
+        // Validators (ETag, Cache-Control) are only filled in for HTTP requests. The
+        // content hash behind an embedded ETag is taken the first time one is asked
+        // for, so the webview path never pays for it.
+        std::optional<Resource> resolveResource(std::string_view path, bool withValidators) {
+            //            if (p.starts_with("http")) {
+            //                return getWebResource(juce::URL(p));
+            //            }
+
+            if (path == "/") {
+                path = "index.html";
+            }
+
+            if (path.starts_with("/$RES/")) {
+                auto relPath = juce::String(std::string (path)).replace("/$RES/", "");
+
+#if JUCE_DEBUG && defined(SRCPATH)
+                auto file = juce::File(juce::String(SRCPATH) + "/../resources/system/resources")
+                        .getChildFile(relPath);
+#else
+                auto file = Resources::getSystemDataFolder().getChildFile("resources")
+                                                                 .getChildFile(relPath);
+#endif
+                return getFileResource(path, file);
+            }
+
+            auto toEmbeddedResource = [&](EmbeddedResource& embedded) {
+                auto r = toResource(embedded.data, embedded.size, embedded.mimeType);
+                if (withValidators) {
+                    if (embedded.etag.empty()) {
+                        embedded.etag = makeETag({reinterpret_cast<const uint8_t*>(embedded.data), embedded.size});
+                    }
+                    r.etag = embedded.etag;
+                    r.cacheControl = isHashedFilename(path) ? immutableCacheControl : revalidateCacheControl;
+                }
+                return r;
+            };
+
+            std::lock_guard l(embeddedResourcesLock);
+            auto entry = embeddedResources.find(path);
+            if (entry == embeddedResources.end()) {
+                auto resolved = resolveEmbeddedResource(path);
+                if (!resolved) return {};
+
+                // different paths can resolve to the same resource, so stop caching
+                // past a cap rather than let requests for made-up paths grow the map
+                if (embeddedResources.size() >= maxEmbeddedResources) {
+                    return toEmbeddedResource(*resolved);
+                }
+
+                entry = embeddedResources.emplace(std::string(path), std::move(*resolved)).first;
+            }
+
+            return toEmbeddedResource(entry->second);
+        }
+
+        struct EmbeddedResource {
+            const char* data;
+            size_t size;
+            std::string mimeType;
+            std::string etag; // empty until first asked for
+        };
+
+        struct PathHash {
+            using is_transparent = void;
+            size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+        };
+
+        // Request path -> resolved BinaryData entry, filled on first request so repeat
+        // lookups are a single hash probe. Misses aren't cached: the socket server
+        // takes requests from the network, and any path can be asked for.
+        std::unordered_map<std::string, EmbeddedResource, PathHash, std::equal_to<>> embeddedResources;
+        static constexpr size_t maxEmbeddedResources = 512;
+        std::mutex embeddedResourcesLock;
+
+        struct CachedFile {
+            std::shared_ptr<const void> owner;
+            std::span<const uint8_t> data;
+            juce::int64 size;
+            juce::int64 modified;
+            std::string mimeType;
+            std::string etag;
+            std::list<std::string>::iterator lruPosition;
+        };
+
+        // /$RES/ path -> file contents. Entries are revalidated against the file's size and
+        // mtime on every hit and evicted least-recently-used past fileCacheBudget bytes.
+        std::unordered_map<std::string, CachedFile, PathHash, std::equal_to<>> fileCache;
+        std::list<std::string> fileCacheLRU;
+        size_t fileCacheBytes {0};
+        size_t fileCacheBudget {64 * 1024 * 1024};
+        size_t fileMapThreshold {4 * 1024 * 1024};
+        std::mutex fileCacheLock;
+
+    public:
+        // Serves a file from disk. Small files are read into a shared MemoryBlock and
+        // cached. A mapping pins its file: Windows refuses to write a file while it's
+        // mapped, and on POSIX truncating a mapped file makes reads past the new end
+        // fault. So big files are mapped for the request only, and the mapping goes
+        // when the last Resource using it does. A file truncated while one of those
+        // is still being sent can still fault, so don't rewrite big assets in place.
+        std::optional<Resource> getFileResource(std::string_view path, const juce::File& file) {
+            const auto size = file.getSize();
+            const auto modified = file.getLastModificationTime().toMilliseconds();
+
+            auto toFileResource = [](const CachedFile& f) {
+                auto r = toResource(reinterpret_cast<const char*>(f.data.data()), f.data.size(), f.mimeType, f.owner);
+                r.etag = f.etag;
+                r.cacheControl = revalidateCacheControl;
+                return r;
+            };
+
+            std::lock_guard l(fileCacheLock);
+            if (auto cached = fileCache.find(path); cached != fileCache.end()) {
+                if (cached->second.size == size && cached->second.modified == modified) {
+                    fileCacheLRU.splice(fileCacheLRU.begin(), fileCacheLRU, cached->second.lruPosition);
+                    return toFileResource(cached->second);
+                }
+                eraseCachedFile(cached);
+            }
+
+            if (!file.existsAsFile()) {
+                return {};
+            }
+
+            CachedFile entry;
+            entry.size = size;
+            entry.modified = modified;
+            // getFileExtension() includes the dot
+            entry.mimeType = getMimeType(file.getFileExtension().substring(1).toStdString());
+            // Files on disk can change, so use a cheap weak validator rather than hashing the contents
+            entry.etag = "W/\"" + std::to_string(size) + "-" + std::to_string(modified) + "\"";
+
+            if (size >= static_cast<juce::int64>(fileMapThreshold)) {
+                auto mapped = std::make_shared<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+                if (mapped->getData() != nullptr) {
+                    entry.data = {static_cast<const uint8_t*>(mapped->getData()), mapped->getSize()};
+                    entry.owner = std::move(mapped);
+                    return toFileResource(entry);
+                }
+                // unmappable, read it instead
+            }
+
+            auto fileData = std::make_shared<juce::MemoryBlock>();
+            file.loadFileAsData(*fileData);
+            entry.data = {static_cast<const uint8_t*>(fileData->getData()), fileData->getSize()};
+            entry.owner = std::move(fileData);
+
+            auto r = toFileResource(entry);
+            if (entry.data.size() > fileCacheBudget) return r;
+
+            fileCacheLRU.emplace_front(path);
+            entry.lruPosition = fileCacheLRU.begin();
+            fileCacheBytes += entry.data.size();
+            fileCache.emplace(std::string(path), std::move(entry));
+            trimFileCache();
+            return r;
+        }
+
+    private:
+        void eraseCachedFile(decltype(fileCache)::iterator entry) {
+            fileCacheBytes -= entry->second.data.size();
+            fileCacheLRU.erase(entry->second.lruPosition);
+            fileCache.erase(entry);
+        }
+
+        void trimFileCache() {
+            while (fileCacheBytes > fileCacheBudget && !fileCacheLRU.empty()) {
+                eraseCachedFile(fileCache.find(fileCacheLRU.back()));
+            }
+        }
+
+        struct EncodedVariants {
+            std::optional<EmbeddedResource> br;
+            std::optional<EmbeddedResource> gzip;
+            std::shared_ptr<const std::string> deflate;
+        };
+
+        // Request path -> encoded variants, resolved (and compressed if needed) once
+        std::unordered_map<std::string, EncodedVariants, PathHash, std::equal_to<>> encodedVariants;
+        std::mutex encodedVariantsLock;
+
+        // Minimum size worth compressing; below this headers outweigh the savings
+        static constexpr size_t minCompressSize = 1024;
+
+        const EncodedVariants& getEncodedVariants(std::string_view path, const std::string& mimeType) {
+            std::lock_guard l(encodedVariantsLock);
+            if (auto existing = encodedVariants.find(path); existing != encodedVariants.end()) {
+                return existing->second;
+            }
+
+            EncodedVariants variants;
+            const auto resourceName = getResourceName(path);
+            variants.br = findEmbeddedVariant(resourceName + "_br", mimeType);
+            variants.gzip = findEmbeddedVariant(resourceName + "_gz", mimeType);
+
+            if (!variants.br && !variants.gzip && isCompressible(mimeType)) {
+                int size = 0;
+                if (auto data = getNamedResource(resourceName.c_str(), size); data && size >= (int) minCompressSize) {
+                    // compress_string produces a zlib stream, which is what HTTP calls "deflate"
+                    auto compressed = compress_string(std::string(data, static_cast<size_t>(size)));
+                    if (compressed.size() < static_cast<size_t>(size)) {
+                        variants.deflate = std::make_shared<const std::string>(std::move(compressed));
+                    }
+                }
+            }
+
+            return encodedVariants.emplace(std::string(path), std::move(variants)).first->second;
+        }
+
+        std::optional<EmbeddedResource> findEmbeddedVariant(const std::string& resourceName,
+                                                            const std::string& mimeType) {
+            int size = 0;
+            auto data = getNamedResource(resourceName.c_str(), size);
+            if (!data) return {};
+            return EmbeddedResource {data, static_cast<size_t>(size), mimeType};
+        }
+
+        static std::string getResourceName(std::string_view path) {
+            auto resourceName = juce::String(std::string(path))
+                    .replace(".", "_")
+                    .replace("-", "").toStdString();
+
+            resourceName = resourceName.substr(resourceName.find_last_of('/') + 1);
+            if (isdigit(resourceName[0])) resourceName = "_" + resourceName;
+            return resourceName;
+        }
+
+        std::optional<EmbeddedResource> resolveEmbeddedResource(std::string_view path) {
+            const auto resourceName = getResourceName(path);
+
+            int resourceSize = 0;
+            const auto resource = getNamedResource(resourceName.c_str(), resourceSize);
+            if (!resource) {
+                jassert(resourceName == "favicon_ico" || resourceName == "index_html"); // probably an error if theres something that isnt the favicon we cant find
+                return {};
+            }
+
+            const auto filePath = std::string(getNamedResourceOriginalFilename(
+                    resourceName.c_str()));
+
+            const auto fileExtension = filePath.substr(filePath.find_last_of('.') + 1);
+            return EmbeddedResource {resource, static_cast<size_t>(resourceSize), getMimeType(fileExtension)};
+        }
     };
 
 }; // namespace imagiro
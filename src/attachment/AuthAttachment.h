@@ -7,18 +7,27 @@
 #include "imagiro_processor/config/AuthorizationManager.h"
 
 namespace imagiro {
-    class AuthAttachment : public UIAttachment, AuthorizationManager::Listener {
+    class AuthAttachment : public UIAttachment, AuthorizationManager::Listener,
+                           UIConnection::FrameListener {
     public:
 
         AuthAttachment(UIConnection& c, AuthorizationManager& a)
                 : UIAttachment(c), authManager(a) {
             authManager.addListener(this);
+            connection.addFrameListener(this);
         }
 
         ~AuthAttachment() override {
+            connection.removeFrameListener(this);
             authManager.removeListener(this);
         }
 
+        void uiFrameStarting() override {}
+
+        void uiResyncRequested() override {
+            onAuthStateChanged(authManager.isAuthorized());
+        }
+
         void addBindings() override {
             connection.bind( "juce_getIsAuthorized",
                                  [&](const choc::value::ValueView &) -> choc::value::Value {
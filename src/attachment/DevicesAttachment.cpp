@@ -10,10 +10,12 @@ namespace imagiro {
     DevicesAttachment::DevicesAttachment(UIConnection &c)
             : UIAttachment(c)
     {
+        connection.addFrameListener(this);
         startTimer(100);
     }
 
     DevicesAttachment::~DevicesAttachment() {
+        connection.removeFrameListener(this);
         stopTimer();
         auto standaloneInstance = juce::StandalonePluginHolder::getInstance();
         if (standaloneInstance) {
@@ -254,6 +256,11 @@ namespace imagiro {
         connection.eval("window.ui.onDevicesChanged");
     }
 
+    void DevicesAttachment::uiResyncRequested() {
+        // a change while no UI was attached would otherwise go unnoticed
+        connection.eval("window.ui.onDevicesChanged");
+    }
+
     void DevicesAttachment::timerCallback() {
         // we have to do this after a delay because getInstance() is null at first
         // kinda hacky but WHATVAAAA
@@ -10,7 +10,7 @@
 
 namespace imagiro {
     class DevicesAttachment : public UIAttachment, juce::ChangeListener,
-                              juce::Timer {
+                              UIConnection::FrameListener, juce::Timer {
     public:
         DevicesAttachment(UIConnection& c);
         ~DevicesAttachment() override;
@@ -20,6 +20,9 @@ namespace imagiro {
         void changeListenerCallback(juce::ChangeBroadcaster *source) override;
         void timerCallback() override;
 
+        void uiFrameStarting() override {}
+        void uiResyncRequested() override;
+
     private:
         juce::Uuid uuid;
     };
@@ -7,18 +7,48 @@
 
 namespace imagiro {
 
-    class ModMatrixAttachment : public UIAttachment, ModMatrix::Listener, juce::Timer {
+    // Changes from the matrix arrive on lock-free queues and are applied to a
+    // message-thread copy, which the UI reads. The 120 Hz timer that drains them
+    // only runs while a UI is attached. While none is, live source and target
+    // values aren't queued at all, and structural changes (connections, sources
+    // and targets coming and going) are drained by an async update instead, so
+    // the copy stays complete for the resync when a UI attaches.
+    class ModMatrixAttachment : public UIAttachment, ModMatrix::Listener, UIConnection::FrameListener,
+                                juce::Timer, juce::AsyncUpdater {
 
     public:
         ModMatrixAttachment(UIConnection& connection, ModMatrix& matrix)
                 : UIAttachment(connection), modMatrix(matrix)
         {
             modMatrix.addListener(this);
-            startTimerHz(120);
+            connection.addFrameListener(this);
+            if (connection.hasConsumers()) startTimerHz(120);
         }
 
         ~ModMatrixAttachment() override {
+            connection.removeFrameListener(this);
             modMatrix.removeListener(this);
+            stopTimer();
+            cancelPendingUpdate();
+        }
+
+        void uiFrameStarting() override {}
+
+        void uiConsumersChanged(bool attached) override {
+            if (attached) startTimerHz(120);
+            else stopTimer();
+        }
+
+        // Only ever pushed, so a UI that attaches or reloads gets all of it again
+        void uiResyncRequested() override {
+            processMatrixCommands();
+            processSourceCommands();
+            processTargetCommands();
+
+            connection.eval("window.ui.modMatrixUpdated", {matrixMessageThread.getState()});
+            for (const auto& [id, source] : sourceValues) sendSourceValue(id);
+            for (const auto& [id, target] : targetValues) sendTargetValue(id);
+            connection.eval("window.ui.onRecentVoiceUpdated", {choc::value::Value(static_cast<int>(mostRecentVoice))});
         }
 
         void OnConnectionAdded(const SourceID& source, const TargetID& target) override {
@@ -34,6 +64,7 @@ namespace imagiro {
                     connection.getSettings().bipolar
                 }
             });
+            drainIfDetached();
         }
 
         void OnConnectionUpdated(const SourceID& source, const TargetID& target) override {
@@ -49,10 +80,12 @@ namespace imagiro {
                     connection.getSettings().bipolar
                 }
             });
+            drainIfDetached();
         }
 
         void OnConnectionRemoved(const SourceID& source, const TargetID& target) override {
             matrixCommands.try_enqueue({ChangeCommandType::Removed, { source, target }});
+            drainIfDetached();
         }
 
         void OnSourceValueAdded(const SourceID& sourceID) override {
@@ -64,9 +97,11 @@ namespace imagiro {
                 source->name,
                 source->bipolar
             });
+            drainIfDetached();
         }
 
         void OnSourceValueUpdated(const SourceID& sourceID, const int voiceIndex) override {
+            if (!connection.hasConsumers()) return;
             const auto source = modMatrix.getSourceValues()[sourceID];
             sourceCommands.try_enqueue({
                 ChangeCommandType::Updated,
@@ -80,13 +115,16 @@ namespace imagiro {
 
         void OnSourceValueRemoved(const SourceID& sourceID) override {
             sourceCommands.try_enqueue({ ChangeCommandType::Removed, sourceID });
+            drainIfDetached();
         }
 
         void OnTargetValueAdded(const TargetID& targetID) override {
             targetCommands.try_enqueue({ ChangeCommandType::Added, targetID });
+            drainIfDetached();
         }
 
         void OnTargetValueUpdated(const TargetID& targetID, const int voiceIndex) override {
+            if (!connection.hasConsumers()) return;
             const auto target = modMatrix.getTargetValues()[targetID];
             targetCommands.try_enqueue({
                 ChangeCommandType::Updated,
@@ -98,10 +136,12 @@ namespace imagiro {
 
         void OnTargetValueReset(const TargetID& targetID) override {
             targetCommands.try_enqueue({ ChangeCommandType::Reset, targetID });
+            drainIfDetached();
         }
 
         void OnTargetValueRemoved(const TargetID& targetID) override {
             targetCommands.try_enqueue({ ChangeCommandType::Removed, targetID });
+            drainIfDetached();
         }
 
         void addBindings() override {
@@ -147,6 +187,10 @@ namespace imagiro {
             processTargetCommands();
         }
 
+        void handleAsyncUpdate() override {
+            timerCallback();
+        }
+
         void processMatrixCommands() {
             MatrixChangeCommand command {};
             bool updated {false};
@@ -166,7 +210,7 @@ namespace imagiro {
                 }
             }
 
-            if (updated) {
+            if (updated && connection.hasConsumers()) {
                 connection.eval("window.ui.modMatrixUpdated", {
                     matrixMessageThread.getState()
                 });
@@ -196,18 +240,8 @@ namespace imagiro {
                 }
             }
 
-            for (const auto id : updatedSources) {
-                const auto mostRecentVoiceValue = sourceValues[id].value.getGlobalValue() +
-                    sourceValues[id].value.getVoiceValue(mostRecentVoice);
-                const auto bipolar = sourceValues[id].bipolar;
-
-                connection.eval("window.ui.sourceValueUpdated", {
-                    choc::value::Value(id),
-                    choc::value::Value(bipolar),
-                    choc::value::Value(static_cast<int>(mostRecentVoice)),
-                    choc::value::Value(mostRecentVoiceValue)
-                });
-            }
+            if (!connection.hasConsumers()) return;
+            for (const auto id : updatedSources) sendSourceValue(id);
         }
 
         void processTargetCommands() {
@@ -233,27 +267,48 @@ namespace imagiro {
                 }
             }
 
-            for (const auto id : updatedTargets) {
-                const auto mostRecentVoiceValue = targetValues[id].value.getGlobalValue() +
-                    targetValues[id].value.getVoiceValue(mostRecentVoice);
-
-                connection.eval("window.ui.targetValueUpdated", {
-                    choc::value::Value(id),
-                    choc::value::Value(static_cast<int>(mostRecentVoice)),
-                    choc::value::Value(mostRecentVoiceValue)
-                });
-            }
+            if (!connection.hasConsumers()) return;
+            for (const auto id : updatedTargets) sendTargetValue(id);
         }
 
         void OnRecentVoiceUpdated(size_t voiceIndex) override {
             mostRecentVoice = voiceIndex;
+            if (!connection.hasConsumers()) return;
             connection.eval("window.ui.onRecentVoiceUpdated", {choc::value::Value((int)voiceIndex)});
         }
 
     private:
         ModMatrix& modMatrix;
 
-        size_t mostRecentVoice;
+        size_t mostRecentVoice {0};
+
+        void drainIfDetached() {
+            if (!connection.hasConsumers()) triggerAsyncUpdate();
+        }
+
+        void sendSourceValue(SourceID id) {
+            const auto mostRecentVoiceValue = sourceValues[id].value.getGlobalValue() +
+                sourceValues[id].value.getVoiceValue(mostRecentVoice);
+            const auto bipolar = sourceValues[id].bipolar;
+
+            connection.eval("window.ui.sourceValueUpdated", {
+                choc::value::Value(id),
+                choc::value::Value(bipolar),
+                choc::value::Value(static_cast<int>(mostRecentVoice)),
+                choc::value::Value(mostRecentVoiceValue)
+            });
+        }
+
+        void sendTargetValue(TargetID id) {
+            const auto mostRecentVoiceValue = targetValues[id].value.getGlobalValue() +
+                targetValues[id].value.getVoiceValue(mostRecentVoice);
+
+            connection.eval("window.ui.targetValueUpdated", {
+                choc::value::Value(id),
+                choc::value::Value(static_cast<int>(mostRecentVoice)),
+                choc::value::Value(mostRecentVoiceValue)
+            });
+        }
 
         SerializedMatrix matrixMessageThread {};
         std::unordered_map<SourceID, ModMatrix::SourceValue> sourceValues;
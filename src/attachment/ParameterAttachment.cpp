@@ -10,14 +10,56 @@ ParameterAttachment::ParameterAttachment(UIConnection &w, Processor& p)
     : UIAttachment(w), processor(p) {
 }
 
+ParameterAttachment::~ParameterAttachment() {
+    connection.removeFrameListener(this);
+}
+
 void ParameterAttachment::addListeners() {
     processor.params().forEach([this](Handle h, const ParamConfig& config) {
+        handles_.push_back(h);
+    });
+    updates_.resize(handles_.size());
+    snapshot_.resize(handles_.size());
+
+    for (size_t i = 0; i < handles_.size(); i++) {
         paramConnections_.push_back(
-            processor.params().uiSignal(h).connect_scoped([this, h](float) {
-                sendStateToBrowser(h);
+            processor.params().uiSignal(handles_[i]).connect_scoped([this, i](float) {
+                updates_.markDirty(i);
             })
         );
+    }
+
+    connection.addFrameListener(this);
+}
+
+void ParameterAttachment::uiResyncRequested() {
+    resyncPending_ = true;
+}
+
+void ParameterAttachment::uiFrameStarting() {
+    if (resyncPending_.exchange(false)) {
+        // a freshly attached UI gets the table and one full snapshot
+        updates_.clearDirty();
+        parameterTableSent_ = false;
+        sendSnapshotToBrowser();
+        return;
+    }
+
+    // uiSignal also fires for writes that leave the value where it was (e.g. a
+    // preset load setting every parameter), so only send what actually moved
+    const auto& changed = updates_.collect([this](size_t slot) {
+        return processor.params().getValue01(handles_[slot]);
     });
+
+    if (updates_.shouldSendSnapshot()) {
+        sendSnapshotToBrowser();
+        return;
+    }
+
+    for (auto slot : changed) {
+        updates_.markSent(slot, processor.params().getValue01(handles_[slot]));
+        sendStateToBrowser(handles_[slot]);
+    }
 }
 
 void ParameterAttachment::addBindings() {
@@ -123,6 +165,22 @@ void ParameterAttachment::addBindings() {
             return getAllParameterSpecValue();
         });
 
+    connection.bind(
+        "juce_getParameterTable",
+        [&](const choc::value::ValueView &args) -> choc::value::Value {
+            parameterTableSent_ = true;
+            return getParameterTableValue();
+        });
+
+    connection.bind(
+        "juce_requestParameterSnapshot",
+        [&](const choc::value::ValueView &args) -> choc::value::Value {
+            // asked for by a page that's just loaded, which won't have the table yet
+            parameterTableSent_ = false;
+            sendSnapshotToBrowser();
+            return {};
+        });
+
     connection.bind(
         "juce_getPluginParameter",
         [&](const choc::value::ValueView &args) -> choc::value::Value {
@@ -145,7 +203,8 @@ void ParameterAttachment::addBindings() {
             auto uv = config.range.denormalize(v01);
 
             return choc::value::Value(uv);
-        });
+        },
+        UIConnection::CallThread::any);
 
     connection.bind(
         "juce_getDisplayValue",
@@ -167,7 +226,8 @@ void ParameterAttachment::addBindings() {
             val.setMember("value", displayStr);
             val.setMember("suffix", ""); // Suffix is now part of the formatted string
             return val;
-        });
+        },
+        UIConnection::CallThread::any);
 
     connection.bind(
         "juce_textToValue01",
@@ -184,7 +244,8 @@ void ParameterAttachment::addBindings() {
 
             auto val01 = config.range.normalize(*parsed);
             return choc::value::Value(val01);
-        });
+        },
+        UIConnection::CallThread::any);
 
     connection.bind(
         "juce_setDisplayValue",
@@ -223,6 +284,30 @@ void ParameterAttachment::sendStateToBrowser(Handle h) {
     connection.eval("window.ui.updateParameterState", {uid, value});
 }
 
+void ParameterAttachment::sendSnapshotToBrowser() {
+    if (!parameterTableSent_) {
+        connection.eval("window.ui.setParameterTable", {getParameterTableValue()});
+        parameterTableSent_ = true;
+    }
+
+    for (size_t i = 0; i < handles_.size(); i++) {
+        snapshot_[i] = processor.params().getValue01(handles_[i]);
+    }
+    updates_.markAllSent(snapshot_);
+
+    connection.evalBinary("window.ui.applyParameterSnapshot",
+                          snapshot_.data(), snapshot_.size() * sizeof(float));
+}
+
+choc::value::Value ParameterAttachment::getParameterTableValue() {
+    // uids in snapshot order, so the UI can map snapshot indices back to parameters
+    auto table = choc::value::createEmptyArray();
+    for (auto h : handles_) {
+        table.addArrayElement(processor.params().config(h).uid);
+    }
+    return table;
+}
+
 choc::value::Value ParameterAttachment::getAllParameterSpecValue() {
     auto params = choc::value::createEmptyArray();
     processor.params().forEach([&](Handle h, const ParamConfig& config) {
@@ -6,22 +6,41 @@
 #include <imagiro_processor/processor/Processor.h>
 #include <imagiro_processor/parameter/ParamController.h>
 #include <sigslot/sigslot.h>
+#include <atomic>
 #include "UIAttachment.h"
+#include "util/ParameterUpdateBatch.h"
 
 namespace imagiro {
-    class ParameterAttachment : public UIAttachment {
+    class ParameterAttachment : public UIAttachment, UIConnection::FrameListener {
     public:
         ParameterAttachment(UIConnection& connection, Processor& p);
-        ~ParameterAttachment() override = default;
+        ~ParameterAttachment() override;
 
         void addListeners() override;
         void addBindings() override;
 
+        void uiFrameStarting() override;
+        void uiResyncRequested() override;
+
     private:
         Processor& processor;
         std::vector<sigslot::scoped_connection> paramConnections_;
 
+        // One slot per parameter, marked by uiSignal and drained once per UI frame,
+        // so each parameter sends at most one update per frame
+        std::vector<Handle> handles_;
+        ParameterUpdateBatch updates_;
+
+        // Handle-indexed float32 values, sent in place of per-parameter updates
+        // when enough parameters change in the same frame
+        std::vector<float> snapshot_;
+
+        bool parameterTableSent_ {false};
+        std::atomic<bool> resyncPending_ {false};
+
         void sendStateToBrowser(Handle h);
+        void sendSnapshotToBrowser();
+        choc::value::Value getParameterTableValue();
         choc::value::Value getAllParameterSpecValue();
         choc::value::Value getParameterSpecValue(Handle h);
     };
@@ -8,25 +8,70 @@
 #include <filesystem>
 
 #include "imagiro_processor/processor/Processor.h"
+#include "imagiro_processor/parameter/ParamController.h"
 #include "imagiro_util/filewatcher/gin_filewatcher.h"
+#include "util/FavoritesStore.h"
+#include "util/ParsedPresetCache.h"
+#include "util/PresetIndex.h"
+#include "util/PresetSearchIndex.h"
 
 namespace imagiro {
 
-class PresetAttachment : public UIAttachment, public FileSystemWatcher::Listener {
+class PresetAttachment : public UIAttachment, public FileSystemWatcher::Listener,
+                         UIConnection::FrameListener {
 public:
     PresetAttachment(UIConnection& connection, Processor& p)
-            : UIAttachment(connection), processor(p)
+            : UIAttachment(connection), processor(p),
+              presetIndex(resources->getPresetsFolder(),
+                          resources->getConfigFile()->getFile().getSiblingFile("presetIndex.json")),
+              favorites(*resources->getConfigFile(),
+                        resources->getConfigFile()->getFile().getSiblingFile("favorites.txt"))
     {
+        presetIndex.load();
+        rebuildPresetsCache();
         watcher.addFolder(resources->getPresetsFolder());
         watcher.addListener(this);
+        connection.addFrameListener(this);
     }
 
     ~PresetAttachment() override {
+        connection.removeFrameListener(this);
         watcher.removeListener(this);
+        // jobs check shouldExit() between files, so this returns after at most one
+        // parse per worker. It has to wait for them all: prefetch jobs use members.
+        prefetchPool.removeAllJobs(true, -1);
+        scanPool.removeAllJobs(true, -1);
+    }
+
+    void uiFrameStarting() override {}
+
+    // The preset list and the loaded preset are only ever pushed, so a UI that
+    // attached or reloaded after they changed is told again
+    void uiResyncRequested() override {
+        connection.eval("window.ui.reloadPresets");
+        if (lastLoadedPreset) {
+            sendPresetChanged("loaded", lastLoadedPresetPath, lastLoadedPreset->metadata().name,
+                              lastLoadedPreset->metadata().description);
+        }
+    }
+
+    void fileChanged(const juce::File file, FileSystemWatcher::FileSystemEvent) override {
+        std::scoped_lock lock(fileActionMutex);
+        changedFiles.push_back(file);
     }
 
     void folderChanged(const juce::File) override {
-        reloadAndNotify();
+        std::vector<juce::File> changed;
+        {
+            std::scoped_lock lock(fileActionMutex);
+            std::swap(changed, changedFiles);
+        }
+
+        if (needsFullScan(changed)) {
+            startScan();
+        } else if (updatePresetFiles(changed)) {
+            connection.eval("window.ui.reloadPresets");
+        }
     }
 
     void addBindings() override {
@@ -41,11 +86,15 @@ public:
         connection.bind(
                 "juce_getAvailablePresets",
                 [&](const choc::value::ValueView &args) -> choc::value::Value {
+                    // Always answer with what we have; a scan streams the rest in
+                    // through window.ui.presetCategoryLoaded
                     auto reloadCache = args[0].getWithDefault(false);
-                    if (reloadCache || presetsCache.empty()) {
-                        reloadPresets();
+                    if (reloadCache || !initialScanStarted) {
+                        initialScanStarted = true;
+                        startScan();
                     }
 
+                    std::scoped_lock lock(fileActionMutex);
                     auto presetState = choc::value::createObject("Presets");
                     for (const auto& [category, presets] : presetsCache) {
                         auto categoryState = choc::value::createEmptyArray();
@@ -58,6 +107,75 @@ public:
                 }
         );
 
+        // Windowed listing for virtualized lists:
+        // args[0] = {category: "" for all, sort: "default" | "name" | "nameDesc" | "favorites", offset, count}
+        // The version changes whenever the list does, so the UI can tell if cached pages are stale.
+        connection.bind(
+                "juce_getPresetsPage",
+                [&](const choc::value::ValueView &args) -> choc::value::Value {
+                    auto query = args[0];
+                    auto category = std::string(query["category"].getWithDefault(""));
+                    auto sort = std::string(query["sort"].getWithDefault("default"));
+                    auto offset = std::max<int64_t>(0, query["offset"].getWithDefault((int64_t) 0));
+                    auto count = std::max<int64_t>(0, query["count"].getWithDefault((int64_t) 100));
+
+                    std::scoped_lock lock(fileActionMutex);
+                    const auto& view = getSortedView(category, sort);
+
+                    auto rows = choc::value::createEmptyArray();
+                    const auto end = getPageEnd(view.size(), offset, count);
+                    for (auto i = static_cast<size_t>(offset); i < end; i++) {
+                        rows.addArrayElement(*presetRows[view[i]]);
+                    }
+
+                    auto page = choc::value::createObject("PresetsPage");
+                    page.setMember("version", static_cast<int64_t>(presetsVersion));
+                    page.setMember("total", static_cast<int64_t>(view.size()));
+                    page.setMember("offset", offset);
+                    page.setMember("rows", rows);
+                    return page;
+                }
+        );
+
+        connection.bind(
+                "juce_searchPresets",
+                [&](const choc::value::ValueView &args) -> choc::value::Value {
+                    auto query = std::string(args[0].getWithDefault(""));
+                    auto offset = args.size() > 1 ? std::max<int64_t>(0, args[1].getWithDefault((int64_t) 0)) : 0;
+                    auto count = args.size() > 2 ? std::max<int64_t>(0, args[2].getWithDefault((int64_t) 50)) : 50;
+                    auto favoritesOnly = args.size() > 3 ? args[3].getWithDefault(false) : false;
+
+                    std::scoped_lock lock(fileActionMutex);
+                    auto hits = searchIndex.search(query, favoritesOnly);
+
+                    auto results = choc::value::createEmptyArray();
+                    const auto end = getPageEnd(hits.size(), offset, count);
+                    for (auto i = static_cast<size_t>(offset); i < end; i++) {
+                        auto row = *presetRows[hits[i].document];
+                        row.setMember("score", hits[i].score);
+                        results.addArrayElement(row);
+                    }
+
+                    auto response = choc::value::createObject("PresetSearchResults");
+                    response.setMember("total", static_cast<int64_t>(hits.size()));
+                    response.setMember("results", results);
+                    return response;
+                }
+        );
+
+        connection.bind(
+                "juce_getPresetParamStates",
+                [&](const choc::value::ValueView &args) -> choc::value::Value {
+                    auto relpath = std::string(args[0].toString());
+                    auto presetFile = resources->getPresetsFolder().getChildFile(relpath);
+                    if (!presetFile.existsAsFile()) return {};
+
+                    auto preset = Preset::loadFromFile(presetFile.getFullPathName().toStdString());
+                    if (!preset) return {};
+                    return paramsToUIState(*preset);
+                }
+        );
+
         connection.bind(
                 "juce_createPreset",
                 [&](const choc::value::ValueView &args) -> choc::value::Value {
@@ -81,11 +199,15 @@ public:
                     preset.saveToFile(presetFile.getFullPathName().toStdString());
 
                     // Load the newly created preset
-                    lastLoadedPreset = preset;
+                    lastLoadedPreset = std::make_shared<const Preset>(std::move(preset));
                     lastLoadedPresetPath = presetFile.getRelativePathFrom(resources->getPresetsFolder()).toStdString();
+                    if (auto signature = ParsedPresetCache::getSignature(presetFile)) {
+                        parsedPresets.put(lastLoadedPresetPath, *signature, lastLoadedPreset);
+                    }
 
-                    reloadAndNotify();
-                    connection.eval("window.ui.presetChanged");
+                    updatePresetFiles({presetFile});
+                    connection.eval("window.ui.reloadPresets");
+                    sendPresetChanged("created", lastLoadedPresetPath, name, description);
                     return {};
                 }
         );
@@ -115,10 +237,7 @@ public:
                     auto j = nlohmann::json::parse(jsonString);
                     auto preset = Preset::fromJson(j);
                     if (preset) {
-                        processor.loadPreset(*preset);
-                        lastLoadedPreset = *preset;
-                        lastLoadedPresetPath = "";
-                        connection.eval("window.ui.presetChanged");
+                        applyPreset(std::make_shared<const Preset>(std::move(*preset)), "");
                     }
                     return {};
                 }
@@ -154,7 +273,8 @@ public:
                         throw std::runtime_error("Failed to save preset file: " + preset->metadata().name);
                     }
 
-                    reloadAndNotify();
+                    updatePresetFiles({presetFile});
+                    connection.eval("window.ui.reloadPresets");
                     return {};
                 }
         );
@@ -166,8 +286,19 @@ public:
                     auto presetFile = resources->getPresetsFolder().getChildFile(relpath);
                     if (!presetFile.exists()) return {};
 
+                    std::string name, description;
+                    {
+                        std::scoped_lock lock(fileActionMutex);
+                        auto entry = presetIndex.getEntries().find(relpath);
+                        if (entry != presetIndex.getEntries().end()) {
+                            name = entry->second.name;
+                            description = entry->second.description;
+                        }
+                    }
+
                     presetFile.deleteFile();
-                    reloadPresets();
+                    if (updatePresetFiles({presetFile})) connection.eval("window.ui.reloadPresets");
+                    sendPresetChanged("deleted", relpath, name, description);
                     return {};
                 }
         );
@@ -178,35 +309,19 @@ public:
                     auto relpath = std::string(args[0].toString());
                     auto shouldFavorite = args[1].getWithDefault(true);
 
-                    // Store favorite status in config
-                    auto& configFile = resources->getConfigFile();
-                    auto favoritesKey = "favorites";
-                    auto favorites = configFile->getValue(favoritesKey, "").toStdString();
-
-                    std::set<std::string> favoriteSet;
-                    if (!favorites.empty()) {
-                        std::stringstream ss(favorites);
-                        std::string item;
-                        while (std::getline(ss, item, '|')) {
-                            favoriteSet.insert(item);
-                        }
-                    }
-
-                    if (shouldFavorite) {
-                        favoriteSet.insert(relpath);
-                    } else {
-                        favoriteSet.erase(relpath);
-                    }
+                    std::scoped_lock lock(fileActionMutex);
+                    if (!favorites.set(relpath, shouldFavorite)) return {};
 
-                    std::string newFavorites;
-                    for (const auto& f : favoriteSet) {
-                        if (!newFavorites.empty()) newFavorites += "|";
-                        newFavorites += f;
+                    // Only the affected row changes; views sorted by favorite are rebuilt on demand
+                    if (auto position = presetPositions.find(relpath); position != presetPositions.end()) {
+                        presetRows[position->second]->setMember("favorite", choc::value::Value(shouldFavorite));
+                        searchIndex.setFavorite(position->second, shouldFavorite);
+                        std::erase_if(sortedViews, [](const auto& view) { return view.first.ends_with("\nfavorites"); });
+                        presetsVersion++;
                     }
-                    configFile->setValue(favoritesKey, juce::String(newFavorites));
-                    configFile->save();
 
-                    reloadPresets();
+                    connection.eval("window.ui.presetFavoriteChanged",
+                                    {choc::value::Value(relpath), choc::value::Value(shouldFavorite)});
                     return {};
                 }
         );
@@ -215,16 +330,10 @@ public:
                 "juce_loadPreset",
                 [&](const choc::value::ValueView &args) -> choc::value::Value {
                     auto relpath = std::string(args[0].toString());
-                    auto presetFile = resources->getPresetsFolder().getChildFile(relpath);
-                    if (!presetFile.exists()) return {};
-
-                    auto preset = Preset::loadFromFile(presetFile.getFullPathName().toStdString());
+                    auto preset = getParsedPreset(relpath);
                     if (!preset) return {};
 
-                    processor.loadPreset(*preset);
-                    lastLoadedPreset = *preset;
-                    lastLoadedPresetPath = relpath;
-                    connection.eval("window.ui.presetChanged");
+                    applyPreset(std::move(preset), relpath);
                     return {};
                 }
         );
@@ -232,27 +341,7 @@ public:
         connection.bind(
                 "juce_nextPreset",
                 [&](const choc::value::ValueView &args) -> choc::value::Value {
-                    auto presetsList = getPresetsList();
-                    if (presetsList.empty()) return {};
-
-                    size_t nextIndex = 0;
-                    if (!lastLoadedPresetPath.empty()) {
-                        for (size_t i = 0; i < presetsList.size(); i++) {
-                            if (presetsList[i] == lastLoadedPresetPath) {
-                                nextIndex = (i + 1) % presetsList.size();
-                                break;
-                            }
-                        }
-                    }
-
-                    auto presetFile = resources->getPresetsFolder().getChildFile(presetsList[nextIndex]);
-                    auto preset = Preset::loadFromFile(presetFile.getFullPathName().toStdString());
-                    if (preset) {
-                        processor.loadPreset(*preset);
-                        lastLoadedPreset = *preset;
-                        lastLoadedPresetPath = presetsList[nextIndex];
-                        connection.eval("window.ui.presetChanged");
-                    }
+                    stepPreset(1);
                     return {};
                 }
         );
@@ -260,27 +349,7 @@ public:
         connection.bind(
                 "juce_prevPreset",
                 [&](const choc::value::ValueView &args) -> choc::value::Value {
-                    auto presetsList = getPresetsList();
-                    if (presetsList.empty()) return {};
-
-                    size_t prevIndex = presetsList.size() - 1;
-                    if (!lastLoadedPresetPath.empty()) {
-                        for (size_t i = 0; i < presetsList.size(); i++) {
-                            if (presetsList[i] == lastLoadedPresetPath) {
-                                prevIndex = (i == 0) ? presetsList.size() - 1 : i - 1;
-                                break;
-                            }
-                        }
-                    }
-
-                    auto presetFile = resources->getPresetsFolder().getChildFile(presetsList[prevIndex]);
-                    auto preset = Preset::loadFromFile(presetFile.getFullPathName().toStdString());
-                    if (preset) {
-                        processor.loadPreset(*preset);
-                        lastLoadedPreset = *preset;
-                        lastLoadedPresetPath = presetsList[prevIndex];
-                        connection.eval("window.ui.presetChanged");
-                    }
+                    stepPreset(-1);
                     return {};
                 }
         );
@@ -347,26 +416,99 @@ public:
 private:
     Processor& processor;
     juce::SharedResourcePointer<Resources> resources;
+    PresetIndex presetIndex;
+    FavoritesStore favorites;
     FileSystemWatcher watcher;
     std::mutex fileActionMutex;
 
-    std::optional<Preset> lastLoadedPreset;
+    // Files reported by the watcher since its last folderChanged
+    std::vector<juce::File> changedFiles;
+
+    bool initialScanStarted {false};
+    bool scanInProgress {false};
+    bool rescanRequested {false};
+
+    // State of the scan in progress, message thread only
+    static constexpr size_t scanBatchSize = 16;
+    std::vector<std::string> scanRemoved;
+    std::map<std::string, size_t> pendingCategoryBatches;
+    size_t pendingBatches {0};
+
+    // shared with parsedPresets, so remembering the loaded preset doesn't copy it
+    std::shared_ptr<const Preset> lastLoadedPreset;
     std::string lastLoadedPresetPath;
+    std::vector<float> valuesBeforeLoad;
 
     // Cache of presets organized by category
     std::map<std::string, std::vector<choc::value::Value>> presetsCache;
 
-    std::set<std::string> getFavorites() {
-        std::set<std::string> favoriteSet;
-        auto favorites = resources->getConfigFile()->getValue("favorites", "").toStdString();
-        if (!favorites.empty()) {
-            std::stringstream ss(favorites);
-            std::string item;
-            while (std::getline(ss, item, '|')) {
-                favoriteSet.insert(item);
+    // Relative paths in list order, and each path's position in it
+    std::vector<std::string> presetOrder;
+    std::unordered_map<std::string, size_t> presetPositions;
+
+    // Rows of presetsCache in presetOrder order; rebuilt with it
+    std::vector<choc::value::Value*> presetRows;
+    // [first, last) of each category's rows in presetRows
+    std::map<std::string, std::pair<size_t, size_t>> categoryRanges;
+    PresetSearchIndex searchIndex;
+
+    // Bumped on every list rebuild; sortedViews are keyed by category + sort
+    uint64_t presetsVersion {0};
+    std::unordered_map<std::string, std::vector<size_t>> sortedViews;
+
+    ParsedPresetCache parsedPresets {8};
+
+    // One past the last row of a page of `count` rows from `offset`, in a list of
+    // `size`. Offsets and counts come from the UI, so offset + count mustn't
+    // overflow; an offset past the end gives an empty page.
+    static size_t getPageEnd(size_t size, int64_t offset, int64_t count) {
+        const auto start = static_cast<uint64_t>(std::max<int64_t>(0, offset));
+        if (start >= size) return size;
+        return static_cast<size_t>(start + std::min<uint64_t>(static_cast<uint64_t>(std::max<int64_t>(0, count)),
+                                                              size - start));
+    }
+
+    // Loads a preset into the processor and tells the UI with a single
+    // presetChanged message carrying the uids of the parameters whose values
+    // actually changed. The values themselves follow on the parameter channel,
+    // which only sends parameters that moved, so auditioning similar presets
+    // costs the UI next to nothing.
+    void applyPreset(std::shared_ptr<const Preset> loaded, const std::string& relpath) {
+        const auto& preset = *loaded;
+        valuesBeforeLoad.clear();
+        processor.params().forEach([&](Handle h, const ParamConfig&) {
+            valuesBeforeLoad.push_back(processor.params().getValue01(h));
+        });
+
+        processor.loadPreset(preset);
+        lastLoadedPreset = std::move(loaded);
+        lastLoadedPresetPath = relpath;
+
+        auto changed = choc::value::createEmptyArray();
+        size_t i = 0;
+        processor.params().forEach([&](Handle h, const ParamConfig& config) {
+            if (i < valuesBeforeLoad.size() && processor.params().getValue01(h) != valuesBeforeLoad[i]) {
+                changed.addArrayElement(config.uid);
             }
-        }
-        return favoriteSet;
+            i++;
+        });
+
+        sendPresetChanged("loaded", relpath, preset.metadata().name, preset.metadata().description, changed);
+
+        if (!relpath.empty()) prefetchNeighbours(relpath);
+    }
+
+    // Creating, loading and deleting presets all reach the UI as one
+    // window.ui.presetChanged message: the preset row plus `reason` ("created",
+    // "loaded" or "deleted") and `changed`, the uids of parameters whose values
+    // moved, which only a load fills in.
+    void sendPresetChanged(const std::string& reason, const std::string& relpath, const std::string& name,
+                           const std::string& description,
+                           const choc::value::Value& changed = choc::value::createEmptyArray()) {
+        auto state = createUIState(relpath, name, description);
+        state.setMember("reason", choc::value::Value(reason));
+        state.setMember("changed", changed);
+        connection.eval("window.ui.presetChanged", {state});
     }
 
     void reloadAndNotify() {
@@ -374,118 +516,424 @@ private:
         connection.eval("window.ui.reloadPresets");
     }
 
+    // Synchronous version of startScan: brings the index up to date (only new or
+    // changed files are parsed) and rebuilds the UI cache from it
     void reloadPresets() {
         std::scoped_lock lock(fileActionMutex);
-        presetsCache.clear();
+        if (presetIndex.refresh()) {
+            removeDuplicateLegacyPresets();
+            presetIndex.save();
+        }
+        rebuildPresetsCache();
+    }
 
-        auto presetsFolder = resources->getPresetsFolder();
-        auto favorites = getFavorites();
-
-        // Scan for preset files (both legacy .impreset and new .json)
-        juce::Array<juce::File> impresetFiles;
-        juce::Array<juce::File> jsonFiles;
-        presetsFolder.findChildFiles(impresetFiles, juce::File::findFiles, true, "*.impreset");
-        presetsFolder.findChildFiles(jsonFiles, juce::File::findFiles, true, "*.json");
-
-        // Build map of json preset names (from metadata) for deduplication
-        // Key: category + "/" + preset.metadata.name
-        std::map<std::string, juce::File> jsonPresetsByName;
-        for (const auto& file : jsonFiles) {
-            auto parentFolder = file.getParentDirectory();
-            auto category = parentFolder == presetsFolder
-                ? "Default"
-                : parentFolder.getFileName().toStdString();
-
-            auto preset = Preset::loadFromFile(file.getFullPathName().toStdString());
-            if (!preset) continue;
-
-            auto presetKey = category + "/" + preset->metadata().name;
-            jsonPresetsByName[presetKey] = file;
+    // Watcher events that don't name preset files (e.g. a category folder being
+    // renamed or removed) need a walk of the whole folder
+    static bool needsFullScan(const std::vector<juce::File>& files) {
+        return files.empty() || std::any_of(files.begin(), files.end(), [](const auto& f) {
+            return !PresetIndex::isPresetFile(f);
+        });
+    }
+
+    // Scans the presets folder on scanPool without blocking the message thread.
+    // Stale files are parsed in parallel in batches of scanBatchSize, and each
+    // category is sent to the UI as soon as all of its batches are in. Must be
+    // called on the message thread.
+    void startScan() {
+        JUCE_ASSERT_MESSAGE_THREAD
+        if (scanInProgress) {
+            rescanRequested = true;
+            return;
         }
+        scanInProgress = true;
 
-        // Process .impreset files, but skip if .json version with same preset name exists
-        for (const auto& file : impresetFiles) {
-            auto parentFolder = file.getParentDirectory();
-            auto category = parentFolder == presetsFolder
-                ? "Default"
-                : parentFolder.getFileName().toStdString();
+        std::map<std::string, PresetIndex::FileSignature> signatures;
+        {
+            std::scoped_lock lock(fileActionMutex);
+            signatures = presetIndex.getSignatures();
+        }
 
-            auto preset = Preset::loadFromFile(file.getFullPathName().toStdString());
-            if (!preset) continue;
+        scanPool.addJob(new PlanScanJob(getScanReader(), std::move(signatures), this), true);
+    }
 
-            auto presetKey = category + "/" + preset->metadata().name;
+    // Scan jobs never touch the attachment. They read the folder through their own
+    // PresetIndex, which holds no entries and only needs the folder path, and hand
+    // results to the message thread through a WeakReference. Each one checks
+    // shouldExit() between files, so the destructor's wait stays short.
+    PresetIndex getScanReader() const {
+        return {resources->getPresetsFolder(), {}};
+    }
+
+    class PlanScanJob : public juce::ThreadPoolJob {
+    public:
+        PlanScanJob(PresetIndex r, std::map<std::string, PresetIndex::FileSignature> s,
+                    juce::WeakReference<PresetAttachment> o)
+                : juce::ThreadPoolJob("Preset scan"), reader(std::move(r)), signatures(std::move(s)), owner(std::move(o)) {}
+
+        JobStatus runJob() override {
+            auto scanPlan = std::make_shared<PresetIndex::ScanPlan>(reader.plan(signatures));
+            if (shouldExit()) return jobHasFinished;
+
+            juce::MessageManager::callAsync([owner = owner, scanPlan] {
+                if (owner) owner->startParsing(std::move(*scanPlan));
+            });
+            return jobHasFinished;
+        }
 
-            // If a .json version with same metadata name exists, delete the old .impreset and skip
-            if (jsonPresetsByName.count(presetKey) > 0) {
-                file.deleteFile();
-                continue;
+    private:
+        PresetIndex reader;
+        std::map<std::string, PresetIndex::FileSignature> signatures;
+        juce::WeakReference<PresetAttachment> owner;
+    };
+
+    class ParseBatchJob : public juce::ThreadPoolJob {
+    public:
+        ParseBatchJob(PresetIndex r, std::string c, std::vector<juce::File> f,
+                      juce::WeakReference<PresetAttachment> o)
+                : juce::ThreadPoolJob("Preset parse"), reader(std::move(r)), category(std::move(c)),
+                  files(std::move(f)), owner(std::move(o)) {}
+
+        JobStatus runJob() override {
+            std::vector<std::pair<std::string, PresetIndex::Entry>> entries;
+            for (const auto& file : files) {
+                if (shouldExit()) return jobHasFinished;
+                if (auto entry = reader.parse(file)) {
+                    entries.emplace_back(reader.getRelativePath(file), std::move(*entry));
+                }
             }
 
-            auto relpath = file.getRelativePathFrom(presetsFolder).toStdString();
-            auto uiState = presetToUIState(*preset, relpath);
-            uiState.setMember("favorite", choc::value::Value(favorites.count(relpath) > 0));
-            presetsCache[category].push_back(uiState);
+            juce::MessageManager::callAsync([owner = owner, category = category, entries = std::move(entries)]() mutable {
+                if (owner) owner->applyScannedBatch(category, std::move(entries));
+            });
+            return jobHasFinished;
         }
 
-        // Process all .json files
-        for (const auto& file : jsonFiles) {
-            auto relpath = file.getRelativePathFrom(presetsFolder).toStdString();
-            auto parentFolder = file.getParentDirectory();
-            auto category = parentFolder == presetsFolder
-                ? "Default"
-                : parentFolder.getFileName().toStdString();
+    private:
+        PresetIndex reader;
+        std::string category;
+        std::vector<juce::File> files;
+        juce::WeakReference<PresetAttachment> owner;
+    };
+
+    void startParsing(PresetIndex::ScanPlan scanPlan) {
+        scanRemoved = std::move(scanPlan.removed);
+        pendingCategoryBatches.clear();
+        pendingBatches = 0;
+
+        if (scanPlan.staleFilesByCategory.empty()) {
+            finishScan(false);
+            return;
+        }
 
-            auto preset = Preset::loadFromFile(file.getFullPathName().toStdString());
-            if (!preset) continue;
+        const auto reader = getScanReader();
+        for (const auto& [category, files] : scanPlan.staleFilesByCategory) {
+            for (size_t first = 0; first < files.size(); first += scanBatchSize) {
+                const auto last = std::min(files.size(), first + scanBatchSize);
+                std::vector<juce::File> batch(files.begin() + static_cast<std::ptrdiff_t>(first),
+                                              files.begin() + static_cast<std::ptrdiff_t>(last));
+                scanPool.addJob(new ParseBatchJob(reader, category, std::move(batch), this), true);
+                pendingCategoryBatches[category]++;
+                pendingBatches++;
+            }
+        }
+    }
 
-            auto uiState = presetToUIState(*preset, relpath);
-            uiState.setMember("favorite", choc::value::Value(favorites.count(relpath) > 0));
-            presetsCache[category].push_back(uiState);
+    void applyScannedBatch(const std::string& category,
+                           std::vector<std::pair<std::string, PresetIndex::Entry>> entries) {
+        {
+            std::scoped_lock lock(fileActionMutex);
+            for (auto& [relpath, entry] : entries) {
+                presetIndex.set(relpath, std::move(entry));
+            }
         }
+
+        if (--pendingCategoryBatches[category] == 0) {
+            pendingCategoryBatches.erase(category);
+            sendScannedCategory(category);
+        }
+
+        if (--pendingBatches == 0) finishScan(true);
     }
 
-    std::vector<std::string> getPresetsList() {
-        std::vector<std::string> list;
-        for (const auto& [category, presets] : presetsCache) {
-            for (const auto& preset : presets) {
-                if (preset.hasObjectMember("path")) {
-                    list.push_back(std::string(preset["path"].getString()));
+    void sendScannedCategory(const std::string& category) {
+        auto categoryState = choc::value::createEmptyArray();
+        {
+            std::scoped_lock lock(fileActionMutex);
+            rebuildPresetsCache(category);
+
+            if (auto presets = presetsCache.find(category); presets != presetsCache.end()) {
+                for (const auto& presetInfo : presets->second) {
+                    categoryState.addArrayElement(presetInfo);
                 }
             }
         }
-        return list;
+
+        connection.eval("window.ui.presetCategoryLoaded", {choc::value::Value(category), categoryState});
+    }
+
+    void finishScan(bool changed) {
+        {
+            std::scoped_lock lock(fileActionMutex);
+            for (const auto& relpath : scanRemoved) {
+                presetIndex.remove(relpath);
+            }
+
+            changed |= !scanRemoved.empty();
+            scanRemoved.clear();
+            if (changed) {
+                removeDuplicateLegacyPresets();
+                presetIndex.save();
+                rebuildPresetsCache();
+            }
+        }
+
+        scanInProgress = false;
+        if (changed) connection.eval("window.ui.reloadPresets");
+
+        if (rescanRequested) {
+            rescanRequested = false;
+            startScan();
+        }
+    }
+
+    // Incremental update for a known set of preset files. Returns true if the index changed.
+    bool updatePresetFiles(const std::vector<juce::File>& files) {
+        std::scoped_lock lock(fileActionMutex);
+
+        bool changed = false;
+        for (const auto& file : files) {
+            changed |= presetIndex.refreshFile(file);
+        }
+
+        if (!changed) return false;
+
+        removeDuplicateLegacyPresets();
+        presetIndex.save();
+        rebuildPresetsCache();
+        return true;
+    }
+
+    // Deletes .impreset files that have a .json preset with the same name in the same category
+    void removeDuplicateLegacyPresets() {
+        std::set<std::string> jsonPresetKeys;
+        for (const auto& [relpath, entry] : presetIndex.getEntries()) {
+            if (!entry.legacy) jsonPresetKeys.insert(entry.category + "/" + entry.name);
+        }
+
+        std::vector<std::string> duplicates;
+        for (const auto& [relpath, entry] : presetIndex.getEntries()) {
+            if (entry.legacy && jsonPresetKeys.count(entry.category + "/" + entry.name) > 0) {
+                duplicates.push_back(relpath);
+            }
+        }
+
+        for (const auto& relpath : duplicates) {
+            resources->getPresetsFolder().getChildFile(relpath).deleteFile();
+            presetIndex.remove(relpath);
+        }
+    }
+
+    // Rebuilds the UI cache from the index, optionally for a single category
+    void rebuildPresetsCache(const std::optional<std::string>& onlyCategory = {}) {
+        if (onlyCategory) presetsCache.erase(*onlyCategory);
+        else presetsCache.clear();
+
+        for (const auto& [relpath, entry] : presetIndex.getEntries()) {
+            if (onlyCategory && entry.category != *onlyCategory) continue;
+            auto uiState = createUIState(relpath, entry.name, entry.description);
+            uiState.setMember("favorite", choc::value::Value(favorites.contains(relpath)));
+            presetsCache[entry.category].push_back(uiState);
+        }
+
+        rebuildPresetOrder();
+    }
+
+    // Flattens presetsCache into browsing order, with a reverse lookup so
+    // next/prev can find the current preset without a search, and rebuilds the
+    // search index over the same rows
+    void rebuildPresetOrder() {
+        presetOrder.clear();
+        presetPositions.clear();
+        presetRows.clear();
+        categoryRanges.clear();
+
+        std::vector<PresetSearchIndex::Document> documents;
+        for (auto& [category, presets] : presetsCache) {
+            categoryRanges[category] = {presetRows.size(), presetRows.size() + presets.size()};
+            for (auto& preset : presets) {
+                presetPositions[std::string(preset["path"].getString())] = presetOrder.size();
+                presetOrder.emplace_back(preset["path"].getString());
+                presetRows.push_back(&preset);
+
+                documents.push_back({std::string(preset["name"].getString()),
+                                     category,
+                                     std::string(preset["description"].getString()),
+                                     preset["favorite"].getBool()});
+            }
+        }
+
+        searchIndex.build(documents);
+        sortedViews.clear();
+        presetsVersion++;
+    }
+
+    // Row indices for one category (or all, if empty) in the given sort order.
+    // Built on first request and kept until the list next changes.
+    // Call with fileActionMutex held.
+    const std::vector<size_t>& getSortedView(const std::string& category, const std::string& sort) {
+        auto key = category + "\n" + sort;
+        if (auto existing = sortedViews.find(key); existing != sortedViews.end()) {
+            return existing->second;
+        }
+
+        std::vector<size_t> view;
+        auto [first, last] = std::pair<size_t, size_t> {0, presetRows.size()};
+        if (!category.empty()) {
+            auto range = categoryRanges.find(category);
+            if (range == categoryRanges.end()) first = last = 0;
+            else std::tie(first, last) = range->second;
+        }
+        for (auto i = first; i < last; i++) view.push_back(i);
+
+        auto name = [&](size_t i) { return juce::String((*presetRows[i])["name"].getString()); };
+        auto favorite = [&](size_t i) { return (*presetRows[i])["favorite"].getBool(); };
+
+        if (sort == "name") {
+            std::stable_sort(view.begin(), view.end(), [&](size_t a, size_t b) {
+                return name(a).compareNatural(name(b)) < 0;
+            });
+        } else if (sort == "nameDesc") {
+            std::stable_sort(view.begin(), view.end(), [&](size_t a, size_t b) {
+                return name(a).compareNatural(name(b)) > 0;
+            });
+        } else if (sort == "favorites") {
+            std::stable_partition(view.begin(), view.end(), favorite);
+        }
+
+        return sortedViews.emplace(std::move(key), std::move(view)).first->second;
+    }
+
+    // Loads the preset `direction` places away from the current one in list order,
+    // wrapping at either end. With nothing loaded, next starts at the first preset
+    // and prev at the last.
+    void stepPreset(int direction) {
+        std::string relpath;
+        {
+            std::scoped_lock lock(fileActionMutex);
+            relpath = getNeighbourPath(lastLoadedPresetPath, direction);
+        }
+        if (relpath.empty()) return;
+
+        if (auto preset = getParsedPreset(relpath)) {
+            applyPreset(std::move(preset), relpath);
+        }
+    }
+
+    // Call with fileActionMutex held
+    std::string getNeighbourPath(const std::string& relpath, int direction) const {
+        if (presetOrder.empty()) return {};
+
+        const auto size = static_cast<long>(presetOrder.size());
+        auto position = presetPositions.find(relpath);
+        if (position == presetPositions.end()) {
+            return direction > 0 ? presetOrder.front() : presetOrder.back();
+        }
+
+        auto index = ((static_cast<long>(position->second) + direction) % size + size) % size;
+        return presetOrder[static_cast<size_t>(index)];
+    }
+
+    // Serves from the parsed-preset LRU when it can, otherwise reads the file
+    std::shared_ptr<const Preset> getParsedPreset(const std::string& relpath) {
+        auto presetFile = resources->getPresetsFolder().getChildFile(relpath);
+        if (auto cached = parsedPresets.get(relpath, presetFile)) return cached;
+
+        auto signature = ParsedPresetCache::getSignature(presetFile);
+        if (!signature) return {};
+
+        auto preset = Preset::loadFromFile(presetFile.getFullPathName().toStdString());
+        if (!preset) return {};
+
+        auto parsed = std::make_shared<const Preset>(std::move(*preset));
+        parsedPresets.put(relpath, *signature, parsed);
+        return parsed;
+    }
+
+    // Parses the presets either side of `relpath` on prefetchPool, so the next
+    // next/prev step is served from memory. It has its own thread so prefetches
+    // don't wait behind a scan's parse batches, and prefetches still waiting for
+    // an earlier load are dropped, since only the latest neighbours matter.
+    void prefetchNeighbours(const std::string& relpath) {
+        std::vector<std::string> neighbours;
+        {
+            std::scoped_lock lock(fileActionMutex);
+            for (auto direction : {1, -1}) {
+                auto neighbour = getNeighbourPath(relpath, direction);
+                if (!neighbour.empty() && neighbour != relpath) neighbours.push_back(neighbour);
+            }
+        }
+
+        prefetchPool.removeAllJobs(false, 0);
+
+        auto presetsFolder = resources->getPresetsFolder();
+        for (const auto& neighbour : neighbours) {
+            if (parsedPresets.contains(neighbour, presetsFolder.getChildFile(neighbour))) continue;
+
+            prefetchPool.addJob([this, presetsFolder, neighbour] {
+                auto file = presetsFolder.getChildFile(neighbour);
+                auto signature = ParsedPresetCache::getSignature(file);
+                if (!signature) return;
+
+                auto preset = Preset::loadFromFile(file.getFullPathName().toStdString());
+                if (preset) {
+                    parsedPresets.put(neighbour, *signature, std::make_shared<const Preset>(std::move(*preset)));
+                }
+            });
+        }
     }
 
     choc::value::Value presetToUIState(const Preset& preset, const std::string& path) {
+        auto state = createUIState(path, preset.metadata().name, preset.metadata().description);
+        state.setMember("paramStates", paramsToUIState(preset));
+        return state;
+    }
+
+    // List rows carry metadata only; param states are fetched per preset
+    // through juce_getPresetParamStates
+    choc::value::Value createUIState(const std::string& path, const std::string& name,
+                                     const std::string& description) {
         auto state = choc::value::createObject("Preset");
         state.setMember("path", choc::value::Value(path));
-        state.setMember("name", choc::value::Value(preset.metadata().name));
-        state.setMember("description", choc::value::Value(preset.metadata().description));
+        state.setMember("name", choc::value::Value(name));
+        state.setMember("description", choc::value::Value(description));
         state.setMember("favorite", choc::value::Value(false));
         state.setMember("available", choc::value::Value(true));
         state.setMember("errorString", choc::value::Value(std::string("")));
+        return state;
+    }
 
+    choc::value::Value paramsToUIState(const Preset& preset) {
         // Convert param states from preset state json
         auto paramStates = choc::value::createEmptyArray();
-        if (preset.state().contains("params")) {
-            auto paramsJson = preset.state()["params"];
-            if (paramsJson.is_object()) {
-                for (auto& [uid, value] : paramsJson.items()) {
-                    auto paramState = choc::value::createObject("ParamState");
-                    paramState.setMember("uid", choc::value::Value(uid));
-                    if (value.is_number()) {
-                        paramState.setMember("value", choc::value::Value(value.get<float>()));
-                    }
-                    paramState.setMember("config", choc::value::Value(std::string("")));
-                    paramState.setMember("locked", choc::value::Value(false));
-                    paramStates.addArrayElement(paramState);
+        if (preset.state().contains("params") && preset.state()["params"].is_object()) {
+            for (auto& [uid, value] : preset.state()["params"].items()) {
+                auto paramState = choc::value::createObject("ParamState");
+                paramState.setMember("uid", choc::value::Value(uid));
+                if (value.is_number()) {
+                    paramState.setMember("value", choc::value::Value(value.get<float>()));
                 }
+                paramState.setMember("config", choc::value::Value(std::string("")));
+                paramState.setMember("locked", choc::value::Value(false));
+                paramStates.addArrayElement(paramState);
             }
         }
-        state.setMember("paramStates", paramStates);
-
-        return state;
+        return paramStates;
     }
+
+    juce::ThreadPool scanPool {juce::jmax(1, juce::SystemStats::getNumCpus() - 1)};
+    juce::ThreadPool prefetchPool {1};
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(PresetAttachment)
 };
 
 } // namespace imagiro
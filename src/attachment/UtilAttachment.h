@@ -7,22 +7,50 @@
 #include "choc/text/choc_JSON.h"
 #include "imagiro_util/BackgroundTaskRunner.h"
 #include "imagiro_util/miniz/compress_string.h"
+#include <deque>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include <string_view>
 
 namespace imagiro {
-    class UtilAttachment : public UIAttachment, BackgroundTaskRunner::Listener {
+    class UtilAttachment : public UIAttachment, BackgroundTaskRunner::Listener,
+                           UIConnection::FrameListener {
     public:
         UtilAttachment(UIConnection& c, Processor& p)
                 : UIAttachment(c), processor(p) {
             backgroundTaskRunner.addListener(this);
+            connection.addFrameListener(this);
         }
 
         ~UtilAttachment() override {
+            connection.removeFrameListener(this);
             backgroundTaskRunner.removeListener(this);
         }
 
+        void uiFrameStarting() override {}
+
+        // Config changes are broadcast to every UI, so resend the ones made this
+        // session to a UI that attached or reloaded after they went out
+        void uiResyncRequested() override {
+            for (const auto& [key, value] : configValuesSent_) {
+                connection.eval("window.ui.configValueUpdated", {
+                    choc::value::Value(key),
+                    value
+                });
+            }
+
+            // a dropped result would leave its promise pending forever. The UI
+            // ignores IDs it has already resolved, so recent ones are just resent.
+            std::lock_guard l(finishedTasksLock_);
+            for (const auto& [taskID, result] : finishedTasks_) {
+                connection.eval("window.ui.onBackgroundTaskFinished", {
+                    choc::value::Value{taskID},
+                    result
+                });
+            }
+        }
+
         // Serialize processor data that should be saved in presets
         choc::value::Value getProcessorDataForPreset() const {
             auto obj = choc::value::createObject({});
@@ -44,9 +72,15 @@ namespace imagiro {
         }
 
         void OnTaskFinished(int taskID, const nlohmann::json& result) override {
+            auto value = choc::json::parse(result.dump());
+            {
+                std::lock_guard l(finishedTasksLock_);
+                finishedTasks_.emplace_back(taskID, value);
+                if (finishedTasks_.size() > maxFinishedTasksKept) finishedTasks_.pop_front();
+            }
             connection.eval("window.ui.onBackgroundTaskFinished", {
                 choc::value::Value{taskID},
-                choc::json::parse(result.dump())
+                value
             });
         }
 
@@ -134,6 +168,7 @@ namespace imagiro {
                         }
 
                         configFile->save();
+                        configValuesSent_[key] = choc::value::Value(args[1]);
                         connection.eval("window.ui.configValueUpdated", {
                             choc::value::Value(args[0]),
                             choc::value::Value(args[1])
@@ -204,12 +239,12 @@ namespace imagiro {
                 const auto fnName = std::string(args[0].getWithDefault(""));
                 const auto fnArgs = choc::value::Value(args[1]);
 
-                if (!connection.getBoundFunctions().contains(fnName)) return {};
-                const auto underlyingFn = connection.getBoundFunctions().at(fnName);
+                const auto fnID = connection.getFunctionID(fnName);
+                if (!fnID) return {};
 
                 BackgroundTaskRunner::Task task;
-                task.fn = [underlyingFn, fnArgs] {
-                    return nlohmann::json::parse(choc::json::toString(underlyingFn(fnArgs)));
+                task.fn = [this, id = *fnID, fnArgs] {
+                    return nlohmann::json::parse(choc::json::toString(connection.callFunction(id, fnArgs)));
                 };
 
                 const auto jobID = backgroundTaskRunner.queueTask(std::move(task));
@@ -226,5 +261,10 @@ namespace imagiro {
         // Storage for arbitrary UI data
         std::unordered_map<std::string, choc::value::Value> processorData_;
         std::unordered_set<std::string> presetKeys_;  // Keys that should be saved in preset
+        std::unordered_map<std::string, choc::value::Value> configValuesSent_;
+
+        static constexpr size_t maxFinishedTasksKept = 16;
+        std::mutex finishedTasksLock_;
+        std::deque<std::pair<int, choc::value::Value>> finishedTasks_;
     };
 }
@@ -0,0 +1,152 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <juce_core/juce_core.h>
+#include <juce_data_structures/juce_data_structures.h>
+#include <juce_events/juce_events.h>
+
+namespace imagiro {
+    // Favorite presets by relative path, held in memory and persisted off the
+    // message thread. Each change is appended to a journal straight away, and the
+    // full set is written to its own file (one path per line) once changes settle,
+    // after which the journal is dropped. On load, any journal left by an unclean
+    // shutdown is replayed over the file.
+    //
+    // Favorites used to live under the config's "favorites" key. That's only read
+    // now, to migrate: the config is saved from the message thread elsewhere, so
+    // writing it from the writer thread would race those saves.
+    class FavoritesStore : juce::Timer {
+    public:
+        FavoritesStore(const juce::PropertiesFile& config, juce::File file)
+            : favoritesFile(std::move(file)), journalFile(favoritesFile.withFileExtension("journal"))
+        {
+            bool migrated = false;
+            if (favoritesFile.existsAsFile()) {
+                juce::StringArray lines;
+                favoritesFile.readLines(lines);
+                for (const auto& path : lines) {
+                    if (path.isNotEmpty()) favorites.insert(path.toStdString());
+                }
+            } else {
+                auto stored = juce::StringArray::fromTokens(config.getValue(legacyFavoritesKey, ""), "|", "");
+                for (const auto& path : stored) {
+                    if (path.isNotEmpty()) favorites.insert(path.toStdString());
+                }
+                migrated = !favorites.empty();
+            }
+
+            writer = std::thread([this] { runWriter(); });
+            if (replayJournal() || migrated) compact();
+        }
+
+        ~FavoritesStore() override {
+            stopTimer();
+            if (dirty) compact();
+
+            // the writer finishes everything queued (at most a few small file
+            // writes) before it exits
+            {
+                std::lock_guard l(writesLock);
+                stopWriter = true;
+            }
+            writesReady.notify_one();
+            writer.join();
+        }
+
+        bool contains(const std::string& relpath) const {
+            return favorites.count(relpath) > 0;
+        }
+
+        // Returns false if the preset was already in that state
+        bool set(const std::string& relpath, bool favorite) {
+            auto changed = favorite ? favorites.insert(relpath).second : favorites.erase(relpath) > 0;
+            if (!changed) return false;
+
+            auto line = juce::String(favorite ? "+" : "-") + relpath + "\n";
+            addWrite([file = journalFile, line] {
+                file.appendText(line, false, false, "\n");
+            });
+
+            dirty = true;
+            startTimer(persistDelayMs);
+            return true;
+        }
+
+    private:
+        static constexpr const char* legacyFavoritesKey = "favorites";
+        static constexpr int persistDelayMs = 2000;
+
+        juce::File favoritesFile;
+        juce::File journalFile;
+        std::unordered_set<std::string> favorites;
+        bool dirty {false};
+
+        // A single thread, so journal appends and compactions run in order
+        std::mutex writesLock;
+        std::condition_variable writesReady;
+        std::deque<std::function<void()>> writes;
+        bool stopWriter {false};
+        std::thread writer;
+
+        void timerCallback() override {
+            stopTimer();
+            compact();
+        }
+
+        // Writes the full set, then drops the journal it supersedes
+        void compact() {
+            dirty = false;
+
+            juce::StringArray paths;
+            for (const auto& path : favorites) paths.add(path);
+            paths.sort(false);
+
+            addWrite([file = favoritesFile, journal = journalFile, text = paths.joinIntoString("\n")] {
+                file.getParentDirectory().createDirectory();
+                if (file.replaceWithText(text)) journal.deleteFile();
+            });
+        }
+
+        void addWrite(std::function<void()> write) {
+            {
+                std::lock_guard l(writesLock);
+                writes.push_back(std::move(write));
+            }
+            writesReady.notify_one();
+        }
+
+        void runWriter() {
+            std::unique_lock l(writesLock);
+            while (true) {
+                writesReady.wait(l, [this] { return stopWriter || !writes.empty(); });
+                if (writes.empty()) return;
+
+                auto write = std::move(writes.front());
+                writes.pop_front();
+
+                l.unlock();
+                write();
+                l.lock();
+            }
+        }
+
+        bool replayJournal() {
+            if (!journalFile.existsAsFile()) return false;
+
+            juce::StringArray lines;
+            journalFile.readLines(lines);
+            for (const auto& line : lines) {
+                if (line.length() < 2) continue;
+                auto path = line.substring(1).toStdString();
+                if (line[0] == '+') favorites.insert(path);
+                else if (line[0] == '-') favorites.erase(path);
+            }
+            return true;
+        }
+    };
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace imagiro {
+    // Collects parameter changes between UI frames. Slots are marked dirty from
+    // any thread and drained once per frame on the message thread, so however
+    // often a parameter is set, the UI gets at most one update for it per frame.
+    // Slots whose value is back where it was last sent are skipped.
+    class ParameterUpdateBatch {
+    public:
+        void resize(size_t numSlots) {
+            dirty = std::make_unique<std::atomic<bool>[]>(numSlots);
+            size = numSlots;
+            changed.clear();
+            changed.reserve(numSlots);
+            lastSent.assign(numSlots, std::numeric_limits<float>::quiet_NaN());
+        }
+
+        // Any thread
+        void markDirty(size_t slot) {
+            dirty[slot].store(true, std::memory_order_relaxed);
+        }
+
+        // Drains the dirty flags and returns the slots whose value01 differs from
+        // the one last sent. The result is reused by the next call.
+        template <typename GetValue01>
+        const std::vector<size_t>& collect(GetValue01&& getValue01) {
+            changed.clear();
+            for (size_t i = 0; i < size; i++) {
+                if (dirty[i].exchange(false, std::memory_order_relaxed) && getValue01(i) != lastSent[i]) {
+                    changed.push_back(i);
+                }
+            }
+            return changed;
+        }
+
+        // Forgets pending changes, for when a full snapshot replaces them
+        void clearDirty() {
+            for (size_t i = 0; i < size; i++) dirty[i].store(false, std::memory_order_relaxed);
+        }
+
+        void markSent(size_t slot, float value01) { lastSent[slot] = value01; }
+        void markAllSent(const std::vector<float>& values01) { lastSent = values01; }
+
+        // a float32 snapshot costs ~6 bytes per parameter once encoded, a single
+        // update message ~60, so past this many changes one snapshot is cheaper
+        static size_t getSnapshotThreshold(size_t numSlots) {
+            return std::max<size_t>(8, numSlots / 8);
+        }
+
+        bool shouldSendSnapshot() const {
+            return changed.size() >= getSnapshotThreshold(size);
+        }
+
+    private:
+        std::unique_ptr<std::atomic<bool>[]> dirty;
+        size_t size {0};
+        std::vector<size_t> changed;
+        // value01 the UI last received for each slot (NaN until first sent)
+        std::vector<float> lastSent;
+    };
+}
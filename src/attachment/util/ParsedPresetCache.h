@@ -0,0 +1,95 @@
+#pragma once
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <juce_core/juce_core.h>
+
+#include "imagiro_processor/processor/Processor.h"
+
+namespace imagiro {
+    // Small thread-safe LRU of parsed presets, keyed by relative path. Each entry
+    // remembers the size and mtime of the file it was parsed from, and lookups
+    // check them against the file on disk, so a preset edited or deleted outside
+    // the plugin (and before the watcher or index catches up) is never served stale.
+    class ParsedPresetCache {
+    public:
+        struct Signature {
+            juce::int64 size {0};
+            juce::int64 modified {0};
+
+            bool operator==(const Signature& other) const {
+                return size == other.size && modified == other.modified;
+            }
+        };
+
+        explicit ParsedPresetCache(size_t maxEntries = 8) : capacity(std::max<size_t>(1, maxEntries)) {}
+
+        // Take this before reading the file, so an edit made while it's being
+        // parsed leaves a mismatched entry rather than a stale one
+        static std::optional<Signature> getSignature(const juce::File& file) {
+            if (!file.existsAsFile()) return {};
+            return Signature {file.getSize(), file.getLastModificationTime().toMilliseconds()};
+        }
+
+        std::shared_ptr<const Preset> get(const std::string& relpath, const juce::File& file) {
+            const auto signature = getSignature(file);
+
+            std::lock_guard l(lock);
+            auto it = entries.find(relpath);
+            if (it == entries.end()) return {};
+            if (!signature || !(it->second.signature == *signature)) {
+                order.erase(it->second.position);
+                entries.erase(it);
+                return {};
+            }
+
+            order.splice(order.begin(), order, it->second.position);
+            return it->second.preset;
+        }
+
+        bool contains(const std::string& relpath, const juce::File& file) {
+            const auto signature = getSignature(file);
+
+            std::lock_guard l(lock);
+            auto it = entries.find(relpath);
+            return it != entries.end() && signature && it->second.signature == *signature;
+        }
+
+        void put(const std::string& relpath, Signature signature, std::shared_ptr<const Preset> preset) {
+            std::lock_guard l(lock);
+            if (auto it = entries.find(relpath); it != entries.end()) {
+                order.erase(it->second.position);
+                entries.erase(it);
+            }
+
+            order.push_front(relpath);
+            entries[relpath] = {std::move(preset), signature, order.begin()};
+
+            while (entries.size() > capacity) {
+                entries.erase(order.back());
+                order.pop_back();
+            }
+        }
+
+        void clear() {
+            std::lock_guard l(lock);
+            entries.clear();
+            order.clear();
+        }
+
+    private:
+        struct Entry {
+            std::shared_ptr<const Preset> preset;
+            Signature signature;
+            std::list<std::string>::iterator position;
+        };
+
+        std::mutex lock;
+        size_t capacity;
+        std::list<std::string> order;
+        std::unordered_map<std::string, Entry> entries;
+    };
+}
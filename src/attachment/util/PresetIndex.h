@@ -0,0 +1,305 @@
+#pragma once
+#include <fstream>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+#include <juce_core/juce_core.h>
+
+#include "imagiro_processor/processor/Processor.h"
+
+namespace imagiro {
+    // Persistent index of the presets folder. Each entry remembers the size and
+    // mtime of the file it was parsed from, so refreshing only reparses files that
+    // are new or have changed since the last scan (or since the cache was saved).
+    // Entries hold listing metadata only; preset state is read on demand.
+    class PresetIndex {
+    public:
+        struct Entry {
+            std::string category;
+            std::string name;
+            std::string description;
+            juce::int64 size {0};
+            juce::int64 modified {0};
+            bool legacy {false};    // .impreset
+        };
+
+        struct FileSignature {
+            juce::int64 size {0};
+            juce::int64 modified {0};
+        };
+
+        // What a refresh needs to do: files to (re)parse, grouped by category, and
+        // entries whose files are gone. Building one only reads the file system, so
+        // it can run off the message thread against a copy of getSignatures().
+        struct ScanPlan {
+            std::map<std::string, std::vector<juce::File>> staleFilesByCategory;
+            std::vector<std::string> removed;
+        };
+
+        PresetIndex(juce::File presets, juce::File cache)
+            : presetsFolder(std::move(presets)), cacheFile(std::move(cache)) {}
+
+        // Relative path -> entry
+        const std::map<std::string, Entry>& getEntries() const { return entries; }
+
+        std::map<std::string, FileSignature> getSignatures() const {
+            std::map<std::string, FileSignature> signatures;
+            for (const auto& [relpath, entry] : entries) {
+                signatures[relpath] = {entry.size, entry.modified};
+            }
+            return signatures;
+        }
+
+        ScanPlan plan(const std::map<std::string, FileSignature>& signatures) const {
+            juce::Array<juce::File> files;
+            presetsFolder.findChildFiles(files, juce::File::findFiles, true, "*.json;*.impreset");
+
+            ScanPlan scanPlan;
+            std::set<std::string> seen;
+            for (const auto& file : files) {
+                auto relpath = getRelativePath(file);
+                seen.insert(relpath);
+
+                auto existing = signatures.find(relpath);
+                if (existing == signatures.end()
+                    || existing->second.size != file.getSize()
+                    || existing->second.modified != file.getLastModificationTime().toMilliseconds()) {
+                    scanPlan.staleFilesByCategory[getCategory(file)].push_back(file);
+                }
+            }
+
+            for (const auto& [relpath, signature] : signatures) {
+                if (seen.count(relpath) == 0) scanPlan.removed.push_back(relpath);
+            }
+
+            return scanPlan;
+        }
+
+        // Walks the folder and brings the index up to date. Returns true if anything changed.
+        bool refresh() {
+            auto scanPlan = plan(getSignatures());
+            bool changed = !scanPlan.removed.empty();
+
+            for (const auto& relpath : scanPlan.removed) {
+                entries.erase(relpath);
+            }
+
+            for (const auto& [category, files] : scanPlan.staleFilesByCategory) {
+                for (const auto& file : files) {
+                    changed |= refreshFile(file);
+                }
+            }
+
+            return changed;
+        }
+
+        // Re-checks a single file: reparses it if it changed, drops it if it's gone.
+        // Returns true if the index changed.
+        bool refreshFile(const juce::File& file) {
+            auto relpath = getRelativePath(file);
+
+            if (!file.existsAsFile() || !isPresetFile(file)) {
+                return entries.erase(relpath) > 0;
+            }
+
+            const auto size = file.getSize();
+            const auto modified = file.getLastModificationTime().toMilliseconds();
+
+            auto existing = entries.find(relpath);
+            if (existing != entries.end()
+                && existing->second.size == size
+                && existing->second.modified == modified) {
+                return false;
+            }
+
+            auto entry = parse(file);
+            if (!entry) {
+                if (existing == entries.end()) return false;
+                entries.erase(existing);
+                return true;
+            }
+
+            entries[relpath] = std::move(*entry);
+            return true;
+        }
+
+        void set(const std::string& relpath, Entry entry) {
+            entries[relpath] = std::move(entry);
+        }
+
+        void remove(const std::string& relpath) {
+            entries.erase(relpath);
+        }
+
+        // Reads a preset file into an entry. Doesn't touch the index, so it's safe
+        // to call from any thread.
+        std::optional<Entry> parse(const juce::File& file) const {
+            Entry entry;
+            entry.size = file.getSize();
+            entry.modified = file.getLastModificationTime().toMilliseconds();
+
+            entry.category = getCategory(file);
+            entry.legacy = file.hasFileExtension("impreset");
+
+            if (!entry.legacy && readMetadata(file, entry)) {
+                return entry;
+            }
+
+            // Legacy or unexpected layouts go through the full loader
+            auto preset = Preset::loadFromFile(file.getFullPathName().toStdString());
+            if (!preset) return {};
+
+            entry.name = preset->metadata().name;
+            entry.description = preset->metadata().description;
+            return entry;
+        }
+
+        // Reads just the "metadata" object of a .json preset. The file is streamed
+        // through a SAX handler that builds nothing but the two strings it wants and
+        // stops at the end of the metadata object. Presets are saved with sorted keys,
+        // so that's before "state", which is never even read from disk.
+        static bool readMetadata(const juce::File& file, Entry& entry) {
+#if JUCE_WINDOWS
+            std::ifstream stream(file.getFullPathName().toWideCharPointer(), std::ios::binary);
+#else
+            std::ifstream stream(file.getFullPathName().toStdString(), std::ios::binary);
+#endif
+            if (!stream.is_open()) return false;
+
+            MetadataReader reader;
+            try {
+                nlohmann::json::sax_parse(stream, &reader);
+            } catch (const std::exception&) {
+                return false;
+            }
+
+            if (!reader.finished || !reader.name) return false;
+            entry.name = std::move(*reader.name);
+            entry.description = std::move(reader.description);
+            return true;
+        }
+
+        // Loads a previously saved index. Entries are still checked against the
+        // files on the next refresh, so a stale cache only costs reparses.
+        void load() {
+            if (!cacheFile.existsAsFile()) return;
+
+            try {
+                auto j = nlohmann::json::parse(cacheFile.loadFileAsString().toStdString());
+                if (j.value("version", 0) != cacheVersion) return;
+
+                entries.clear();
+                for (auto& [relpath, e] : j["entries"].items()) {
+                    Entry entry;
+                    entry.category = e.value("category", "");
+                    entry.name = e.value("name", "");
+                    entry.description = e.value("description", "");
+                    entry.size = e.value("size", (juce::int64) 0);
+                    entry.modified = e.value("modified", (juce::int64) 0);
+                    entry.legacy = e.value("legacy", false);
+                    entries[relpath] = std::move(entry);
+                }
+            } catch (const std::exception&) {
+                entries.clear();
+            }
+        }
+
+        void save() const {
+            nlohmann::json j;
+            j["version"] = cacheVersion;
+            auto& out = j["entries"];
+            out = nlohmann::json::object();
+            for (const auto& [relpath, entry] : entries) {
+                out[relpath] = {
+                        {"category", entry.category},
+                        {"name", entry.name},
+                        {"description", entry.description},
+                        {"size", entry.size},
+                        {"modified", entry.modified},
+                        {"legacy", entry.legacy}
+                };
+            }
+
+            cacheFile.getParentDirectory().createDirectory();
+            cacheFile.replaceWithText(j.dump());
+        }
+
+        std::string getRelativePath(const juce::File& file) const {
+            return file.getRelativePathFrom(presetsFolder).toStdString();
+        }
+
+        std::string getCategory(const juce::File& file) const {
+            auto parentFolder = file.getParentDirectory();
+            return parentFolder == presetsFolder
+                   ? "Default"
+                   : parentFolder.getFileName().toStdString();
+        }
+
+        static bool isPresetFile(const juce::File& file) {
+            return file.hasFileExtension("json;impreset");
+        }
+
+    private:
+        static constexpr int cacheVersion = 2;
+
+        struct MetadataReader : nlohmann::json_sax<nlohmann::json> {
+            std::optional<std::string> name;
+            std::string description;
+            bool finished {false};
+
+            bool null() override { return true; }
+            bool boolean(bool) override { return true; }
+            bool number_integer(number_integer_t) override { return true; }
+            bool number_unsigned(number_unsigned_t) override { return true; }
+            bool number_float(number_float_t, const string_t&) override { return true; }
+            bool binary(binary_t&) override { return true; }
+
+            bool string(string_t& value) override {
+                if (inMetadata && depth == 2) {
+                    if (currentKey == "name") name = value;
+                    else if (currentKey == "description") description = value;
+                }
+                return true;
+            }
+
+            bool key(string_t& k) override {
+                if (depth == 1 || (inMetadata && depth == 2)) currentKey = k;
+                return true;
+            }
+
+            bool start_object(std::size_t) override {
+                depth++;
+                if (depth == 2 && currentKey == "metadata") inMetadata = true;
+                return true;
+            }
+
+            bool end_object() override {
+                // returning false stops the parse, leaving the rest of the file unread
+                if (inMetadata && depth == 2) {
+                    finished = true;
+                    return false;
+                }
+                depth--;
+                return true;
+            }
+
+            bool start_array(std::size_t) override { depth++; return true; }
+            bool end_array() override { depth--; return true; }
+
+            bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) override {
+                return false;
+            }
+
+        private:
+            int depth {0};
+            bool inMetadata {false};
+            std::string currentKey;
+        };
+
+        juce::File presetsFolder;
+        juce::File cacheFile;
+        std::map<std::string, Entry> entries;
+    };
+}
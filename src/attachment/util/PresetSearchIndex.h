@@ -0,0 +1,220 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace imagiro {
+    // In-memory search index over the preset library. Names, categories and
+    // descriptions are split into lowercase tokens and kept in one sorted term
+    // table, so a query token resolves by binary search (exact and prefix matches)
+    // with a bounded edit-distance pass over the terms for typos.
+    class PresetSearchIndex {
+    public:
+        struct Document {
+            std::string name;
+            std::string category;
+            std::string description;
+            bool favorite {false};
+        };
+
+        struct Hit {
+            size_t document;
+            float score;
+        };
+
+        // Replaces the index contents. Document indices in results refer to positions in `documents`.
+        void build(const std::vector<Document>& documents) {
+            terms.clear();
+            favorites.assign(documents.size(), false);
+            names.resize(documents.size());
+
+            std::vector<std::pair<std::string, Posting>> occurrences;
+            for (size_t i = 0; i < documents.size(); i++) {
+                const auto& doc = documents[i];
+                favorites[i] = doc.favorite;
+                names[i] = toLower(doc.name);
+
+                for (auto& token : tokenize(doc.name)) occurrences.push_back({std::move(token), {i, nameWeight}});
+                for (auto& token : tokenize(doc.category)) occurrences.push_back({std::move(token), {i, categoryWeight}});
+                for (auto& token : tokenize(doc.description)) occurrences.push_back({std::move(token), {i, descriptionWeight}});
+            }
+
+            std::sort(occurrences.begin(), occurrences.end(), [](const auto& a, const auto& b) {
+                return a.first != b.first ? a.first < b.first : a.second.document < b.second.document;
+            });
+
+            for (auto& [token, posting] : occurrences) {
+                if (terms.empty() || terms.back().text != token) {
+                    terms.push_back({std::move(token), {}});
+                }
+
+                auto& postings = terms.back().postings;
+                // keep one posting per document, at its best field weight
+                if (!postings.empty() && postings.back().document == posting.document) {
+                    postings.back().weight = std::max(postings.back().weight, posting.weight);
+                } else {
+                    postings.push_back(posting);
+                }
+            }
+        }
+
+        void setFavorite(size_t document, bool favorite) {
+            if (document < favorites.size()) favorites[document] = favorite;
+        }
+
+        // Every query token has to match some term in a document. Results are ranked
+        // by score (field weight times match quality, favorites boosted), then name.
+        // An empty query matches everything in index order.
+        std::vector<Hit> search(std::string_view query, bool favoritesOnly = false) const {
+            const auto queryTokens = tokenize(query);
+            std::vector<Hit> hits;
+
+            if (queryTokens.empty()) {
+                for (size_t i = 0; i < favorites.size(); i++) {
+                    if (!favoritesOnly || favorites[i]) hits.push_back({i, 0.f});
+                }
+                return hits;
+            }
+
+            std::vector<float> scores(favorites.size(), 0.f);
+            std::vector<size_t> matchedTokens(favorites.size(), 0);
+            std::vector<float> tokenScores(favorites.size());
+            DistanceRows rows;
+
+            for (const auto& token : queryTokens) {
+                std::fill(tokenScores.begin(), tokenScores.end(), 0.f);
+                matchTerms(token, tokenScores, rows);
+
+                for (size_t i = 0; i < tokenScores.size(); i++) {
+                    if (tokenScores[i] > 0.f) {
+                        scores[i] += tokenScores[i];
+                        matchedTokens[i]++;
+                    }
+                }
+            }
+
+            for (size_t i = 0; i < scores.size(); i++) {
+                if (matchedTokens[i] != queryTokens.size()) continue;
+                if (favoritesOnly && !favorites[i]) continue;
+                hits.push_back({i, favorites[i] ? scores[i] * favoriteBoost : scores[i]});
+            }
+
+            std::sort(hits.begin(), hits.end(), [this](const Hit& a, const Hit& b) {
+                return a.score != b.score ? a.score > b.score : names[a.document] < names[b.document];
+            });
+            return hits;
+        }
+
+        // Tokens are runs of ASCII letters and digits, lowercased, plus any bytes
+        // >= 0x80, so names in UTF-8 (accents, CJK...) are kept whole rather than
+        // split apart. Only ASCII is case-folded.
+        static std::vector<std::string> tokenize(std::string_view text) {
+            std::vector<std::string> tokens;
+            std::string current;
+            for (auto c : text) {
+                const auto byte = static_cast<unsigned char>(c);
+                if (byte >= 0x80) {
+                    current += c;
+                } else if (std::isalnum(byte)) {
+                    current += static_cast<char>(std::tolower(byte));
+                } else if (!current.empty()) {
+                    tokens.push_back(std::move(current));
+                    current.clear();
+                }
+            }
+            if (!current.empty()) tokens.push_back(std::move(current));
+            return tokens;
+        }
+
+    private:
+        struct Posting {
+            size_t document;
+            float weight;
+        };
+
+        struct Term {
+            std::string text;
+            std::vector<Posting> postings;
+        };
+
+        static constexpr float nameWeight = 3.f;
+        static constexpr float categoryWeight = 2.f;
+        static constexpr float descriptionWeight = 1.f;
+
+        static constexpr float exactMatch = 1.f;
+        static constexpr float prefixMatch = 0.7f;
+        static constexpr float fuzzyMatch = 0.4f;
+        static constexpr float favoriteBoost = 1.2f;
+
+        std::vector<Term> terms;
+        std::vector<bool> favorites;
+        std::vector<std::string> names;
+
+        // Rows for withinDistance, kept for a whole search so the fuzzy pass over
+        // every term doesn't allocate
+        struct DistanceRows {
+            std::vector<size_t> previous, current;
+        };
+
+        void matchTerms(const std::string& token, std::vector<float>& tokenScores, DistanceRows& rows) const {
+            auto addPostings = [&](const Term& term, float quality) {
+                for (const auto& posting : term.postings) {
+                    tokenScores[posting.document] = std::max(tokenScores[posting.document], posting.weight * quality);
+                }
+            };
+
+            // exact and prefix matches are a contiguous run starting at lower_bound
+            auto it = std::lower_bound(terms.begin(), terms.end(), token, [](const Term& t, const std::string& s) {
+                return t.text < s;
+            });
+            for (; it != terms.end() && std::string_view(it->text).starts_with(token); ++it) {
+                addPostings(*it, it->text.size() == token.size() ? exactMatch : prefixMatch);
+            }
+
+            // short tokens would match almost anything with a typo allowed
+            if (token.size() < 4) return;
+            const size_t maxDistance = token.size() >= 8 ? 2 : 1;
+
+            for (const auto& term : terms) {
+                if (term.text.size() + maxDistance < token.size()) continue;
+                // compare against the term's leading characters so prefixes with typos match too
+                auto candidate = std::string_view(term.text).substr(0, token.size() + maxDistance);
+                if (candidate.starts_with(token)) continue;
+                if (withinDistance(token, candidate, maxDistance, rows)) addPostings(term, fuzzyMatch);
+            }
+        }
+
+        // Levenshtein distance of `a` to the closest prefix of `b`, bounded by maxDistance
+        static bool withinDistance(std::string_view a, std::string_view b, size_t maxDistance, DistanceRows& rows) {
+            auto& previous = rows.previous;
+            auto& current = rows.current;
+            previous.resize(b.size() + 1);
+            current.resize(b.size() + 1);
+            for (size_t j = 0; j <= b.size(); j++) previous[j] = j;
+
+            for (size_t i = 1; i <= a.size(); i++) {
+                current[0] = i;
+                auto rowMin = current[0];
+                for (size_t j = 1; j <= b.size(); j++) {
+                    auto substitution = previous[j - 1] + (a[i - 1] == b[j - 1] ? 0 : 1);
+                    current[j] = std::min({previous[j] + 1, current[j - 1] + 1, substitution});
+                    rowMin = std::min(rowMin, current[j]);
+                }
+                if (rowMin > maxDistance) return false;
+                std::swap(previous, current);
+            }
+
+            return *std::min_element(previous.begin(), previous.end()) <= maxDistance;
+        }
+
+        static std::string toLower(std::string_view s) {
+            std::string lower(s);
+            std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) {
+                return c < 0x80 ? static_cast<char>(std::tolower(c)) : static_cast<char>(c);
+            });
+            return lower;
+        }
+    };
+}
@@ -14,5 +14,8 @@ namespace imagiro {
         void evalFunction(const std::string &functionName, const std::vector<choc::value::ValueView>& args) {
             //
         }
+        void evalBinaryFunction(const std::string &functionName, const void* data, size_t size) override {
+            //
+        }
     };
 }
@@ -0,0 +1,163 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace imagiro {
+    // Fixed-capacity ring of preallocated message slots used by the connections to
+    // hold evals until the next UI tick. Slots keep their string capacity between
+    // uses, so steady-state traffic doesn't allocate, and the queue never grows
+    // while nobody is draining it. A full queue loses something whatever the
+    // policy, and one-shot events can't be told apart from state, so owners
+    // should check takeDropped() each tick and resync the UI when it's set.
+    class EvalQueue {
+    public:
+        enum class OverflowPolicy {
+            dropOldest,     // overwrite the oldest queued message
+            dropNewest,     // discard the incoming message
+            coalesceByKey   // replace the queued message with the same key, else drop the oldest
+        };
+
+        struct Message {
+            std::string key;
+            std::string functionName;
+            std::string payload;
+            std::string packedPayload; // optional second encoding, for connections with a binary wire format
+        };
+
+        struct Stats {
+            uint64_t enqueued {0};
+            uint64_t dropped {0};
+            size_t depth {0};
+            size_t peakDepth {0};
+        };
+
+        explicit EvalQueue(size_t capacity, OverflowPolicy policy = OverflowPolicy::dropOldest,
+                           size_t slotReserveBytes = 256)
+            : slots(std::max<size_t>(1, capacity)), overflowPolicy(policy)
+        {
+            for (auto& slot : slots) {
+                slot.payload.reserve(slotReserveBytes);
+            }
+        }
+
+        void setOverflowPolicy(OverflowPolicy policy) {
+            std::lock_guard l(lock);
+            overflowPolicy = policy;
+        }
+
+        void push(std::string_view key, std::string_view functionName, std::string_view payload,
+                  std::string_view packedPayload = {}) {
+            std::lock_guard l(lock);
+            stats.enqueued++;
+
+            if (count == slots.size()) {
+                stats.dropped++;
+                droppedSinceCheck = true;
+
+                if (overflowPolicy == OverflowPolicy::dropNewest) return;
+
+                if (overflowPolicy == OverflowPolicy::coalesceByKey && !key.empty()) {
+                    for (size_t i = 0; i < count; i++) {
+                        auto& slot = slots[(head + i) % slots.size()];
+                        if (slot.key == key) {
+                            assign(slot, key, functionName, payload, packedPayload);
+                            return;
+                        }
+                    }
+                }
+
+                head = (head + 1) % slots.size();
+                count--;
+            }
+
+            assign(slots[(head + count) % slots.size()], key, functionName, payload, packedPayload);
+            count++;
+            stats.peakDepth = std::max(stats.peakDepth, count);
+        }
+
+        // Moves the oldest message into `out`. The slot takes over out's buffers,
+        // so reusing the same `out` keeps both sides allocation-free.
+        bool pop(Message& out) {
+            std::lock_guard l(lock);
+            if (count == 0) return false;
+
+            swapContents(out, slots[head]);
+
+            head = (head + 1) % slots.size();
+            count--;
+            return true;
+        }
+
+        // Moves queued messages, oldest first, into the front of `out`, stopping once
+        // the next would take the total past maxBytes (at least one is always taken).
+        // Returns how many were moved. Like pop(), buffers are swapped rather than
+        // copied, so the lock is only held for the swaps and a reused `out` doesn't
+        // allocate. `out` only ever grows; entries past the count are left as spares.
+        size_t popBatch(std::vector<Message>& out, size_t maxBytes) {
+            std::lock_guard l(lock);
+            size_t taken = 0, bytes = 0;
+            while (count > 0) {
+                auto& slot = slots[head];
+                auto size = slot.functionName.size() + slot.payload.size();
+                if (taken > 0 && bytes + size > maxBytes) break;
+
+                if (taken == out.size()) out.emplace_back();
+                swapContents(out[taken++], slot);
+                bytes += size;
+
+                head = (head + 1) % slots.size();
+                count--;
+            }
+            return taken;
+        }
+
+        // True if a message was dropped or replaced by overflow since the last call
+        bool takeDropped() {
+            std::lock_guard l(lock);
+            return std::exchange(droppedSinceCheck, false);
+        }
+
+        void clear() {
+            std::lock_guard l(lock);
+            head = 0;
+            count = 0;
+            droppedSinceCheck = false;
+        }
+
+        Stats getStats() const {
+            std::lock_guard l(lock);
+            auto s = stats;
+            s.depth = count;
+            return s;
+        }
+
+    private:
+        static void swapContents(Message& a, Message& b) {
+            std::swap(a.key, b.key);
+            std::swap(a.functionName, b.functionName);
+            std::swap(a.payload, b.payload);
+            std::swap(a.packedPayload, b.packedPayload);
+        }
+
+        static void assign(Message& slot, std::string_view key, std::string_view functionName,
+                           std::string_view payload, std::string_view packedPayload) {
+            slot.key.assign(key);
+            slot.functionName.assign(functionName);
+            slot.payload.assign(payload);
+            slot.packedPayload.assign(packedPayload);
+        }
+
+        mutable std::mutex lock;
+        std::vector<Message> slots;
+        size_t head {0};
+        size_t count {0};
+        OverflowPolicy overflowPolicy;
+        Stats stats;
+        bool droppedSinceCheck {false};
+    };
+}
@@ -0,0 +1,221 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <choc/containers/choc_Value.h>
+
+// Minimal MessagePack codec for choc values, used as the binary wire format for
+// socket clients that ask for it. Our messages are mostly short names and a few
+// numbers, so it isn't meaningfully smaller than JSON; what it saves is printing
+// and parsing numbers as text. Objects become maps keyed by member name, vectors
+// and arrays both become arrays, and void becomes nil. Decoding also accepts bin,
+// as a string holding the bytes, since browser libraries send Uint8Arrays that
+// way. Ext types have no choc equivalent and are rejected.
+namespace imagiro::msgpack {
+
+    namespace detail {
+        inline void writeBigEndian(std::string& out, uint64_t v, int numBytes) {
+            for (auto i = numBytes - 1; i >= 0; i--) {
+                out += static_cast<char>((v >> (i * 8)) & 0xff);
+            }
+        }
+
+        inline void writeHeader(std::string& out, size_t size, uint8_t fixBase, size_t fixMax,
+                                uint8_t type8, uint8_t type16, uint8_t type32) {
+            if (size <= fixMax) {
+                out += static_cast<char>(fixBase | size);
+            } else if (type8 != 0 && size <= 0xff) {
+                out += static_cast<char>(type8);
+                writeBigEndian(out, size, 1);
+            } else if (size <= 0xffff) {
+                out += static_cast<char>(type16);
+                writeBigEndian(out, size, 2);
+            } else {
+                out += static_cast<char>(type32);
+                writeBigEndian(out, size, 4);
+            }
+        }
+
+        inline void writeInt(std::string& out, int64_t i) {
+            if (i >= 0 && i <= 0x7f) {
+                out += static_cast<char>(i);
+            } else if (i >= -32 && i < 0) {
+                out += static_cast<char>(static_cast<int8_t>(i));
+            } else if (i >= INT32_MIN && i <= INT32_MAX) {
+                out += static_cast<char>(0xd2);
+                writeBigEndian(out, static_cast<uint32_t>(i), 4);
+            } else {
+                out += static_cast<char>(0xd3);
+                writeBigEndian(out, static_cast<uint64_t>(i), 8);
+            }
+        }
+
+        inline void writeString(std::string& out, std::string_view s) {
+            writeHeader(out, s.size(), 0xa0, 31, 0xd9, 0xda, 0xdb);
+            out.append(s.data(), s.size());
+        }
+
+        inline void encode(std::string& out, const choc::value::ValueView& v) {
+            if (v.isBool()) {
+                out += static_cast<char>(v.getBool() ? 0xc3 : 0xc2);
+            } else if (v.isInt32() || v.isInt64()) {
+                writeInt(out, v.isInt32() ? static_cast<int64_t>(v.getInt32()) : v.getInt64());
+            } else if (v.isFloat32()) {
+                auto f = v.getFloat32();
+                uint32_t bits;
+                std::memcpy(&bits, &f, sizeof(bits));
+                out += static_cast<char>(0xca);
+                writeBigEndian(out, bits, 4);
+            } else if (v.isFloat64()) {
+                auto d = v.getFloat64();
+                uint64_t bits;
+                std::memcpy(&bits, &d, sizeof(bits));
+                out += static_cast<char>(0xcb);
+                writeBigEndian(out, bits, 8);
+            } else if (v.isString()) {
+                writeString(out, v.getString());
+            } else if (v.isArray() || v.isVector()) {
+                writeHeader(out, v.size(), 0x90, 15, 0, 0xdc, 0xdd);
+                for (uint32_t i = 0; i < v.size(); i++) encode(out, v[i]);
+            } else if (v.isObject()) {
+                writeHeader(out, v.size(), 0x80, 15, 0, 0xde, 0xdf);
+                for (uint32_t i = 0; i < v.size(); i++) {
+                    auto member = v.getObjectMemberAt(i);
+                    writeString(out, member.name);
+                    encode(out, member.value);
+                }
+            } else {
+                out += static_cast<char>(0xc0);
+            }
+        }
+
+        struct Reader {
+            // Input comes off the network, so nesting is capped to keep the
+            // recursion from running off the stack
+            static constexpr int maxDepth = 64;
+
+            std::string_view data;
+            size_t pos = 0;
+            int depth = 0;
+
+            struct Nested {
+                explicit Nested(Reader& r) : reader(r) {
+                    if (++reader.depth > maxDepth) throw std::runtime_error("msgpack: nesting too deep");
+                }
+                ~Nested() { --reader.depth; }
+                Reader& reader;
+            };
+
+            uint64_t readBigEndian(int numBytes) {
+                if (pos + numBytes > data.size()) throw std::runtime_error("msgpack: unexpected end of data");
+                uint64_t v = 0;
+                for (auto i = 0; i < numBytes; i++) {
+                    v = (v << 8) | static_cast<uint8_t>(data[pos++]);
+                }
+                return v;
+            }
+
+            std::string_view readBytes(size_t size) {
+                if (pos + size > data.size()) throw std::runtime_error("msgpack: unexpected end of data");
+                auto bytes = data.substr(pos, size);
+                pos += size;
+                return bytes;
+            }
+
+            choc::value::Value readArray(size_t size) {
+                Nested nested(*this);
+                auto array = choc::value::createEmptyArray();
+                for (size_t i = 0; i < size; i++) array.addArrayElement(read());
+                return array;
+            }
+
+            choc::value::Value readMap(size_t size) {
+                Nested nested(*this);
+                auto object = choc::value::createObject("");
+                for (size_t i = 0; i < size; i++) {
+                    auto key = read();
+                    if (!key.isString()) throw std::runtime_error("msgpack: only string map keys are supported");
+                    object.addMember(key.getString(), read());
+                }
+                return object;
+            }
+
+            choc::value::Value read() {
+                const auto type = static_cast<uint8_t>(readBigEndian(1));
+
+                if (type <= 0x7f) return choc::value::Value(static_cast<int32_t>(type));
+                if (type >= 0xe0) return choc::value::Value(static_cast<int32_t>(static_cast<int8_t>(type)));
+                if ((type & 0xe0) == 0xa0) return choc::value::Value(readBytes(type & 0x1f));
+                if ((type & 0xf0) == 0x90) return readArray(type & 0x0f);
+                if ((type & 0xf0) == 0x80) return readMap(type & 0x0f);
+
+                switch (type) {
+                    case 0xc0: return {};
+                    case 0xc1: throw std::runtime_error("msgpack: 0xc1 is never used");
+                    case 0xc2: return choc::value::Value(false);
+                    case 0xc3: return choc::value::Value(true);
+                    case 0xc4: return choc::value::Value(readBytes(readBigEndian(1)));
+                    case 0xc5: return choc::value::Value(readBytes(readBigEndian(2)));
+                    case 0xc6: return choc::value::Value(readBytes(readBigEndian(4)));
+                    case 0xc7: case 0xc8: case 0xc9:
+                    case 0xd4: case 0xd5: case 0xd6: case 0xd7: case 0xd8:
+                        throw std::runtime_error("msgpack: ext types aren't supported");
+                    case 0xca: {
+                        auto bits = static_cast<uint32_t>(readBigEndian(4));
+                        float f;
+                        std::memcpy(&f, &bits, sizeof(f));
+                        return choc::value::Value(f);
+                    }
+                    case 0xcb: {
+                        auto bits = readBigEndian(8);
+                        double d;
+                        std::memcpy(&d, &bits, sizeof(d));
+                        return choc::value::Value(d);
+                    }
+                    case 0xcc: return choc::value::Value(static_cast<int32_t>(readBigEndian(1)));
+                    case 0xcd: return choc::value::Value(static_cast<int32_t>(readBigEndian(2)));
+                    case 0xce: return choc::value::Value(static_cast<int64_t>(readBigEndian(4)));
+                    case 0xcf: {
+                        auto u = readBigEndian(8);
+                        if (u > static_cast<uint64_t>(INT64_MAX)) throw std::runtime_error("msgpack: uint64 out of range");
+                        return choc::value::Value(static_cast<int64_t>(u));
+                    }
+                    case 0xd0: return choc::value::Value(static_cast<int32_t>(static_cast<int8_t>(readBigEndian(1))));
+                    case 0xd1: return choc::value::Value(static_cast<int32_t>(static_cast<int16_t>(readBigEndian(2))));
+                    case 0xd2: return choc::value::Value(static_cast<int32_t>(readBigEndian(4)));
+                    case 0xd3: return choc::value::Value(static_cast<int64_t>(readBigEndian(8)));
+                    case 0xd9: return choc::value::Value(readBytes(readBigEndian(1)));
+                    case 0xda: return choc::value::Value(readBytes(readBigEndian(2)));
+                    case 0xdb: return choc::value::Value(readBytes(readBigEndian(4)));
+                    case 0xdc: return readArray(readBigEndian(2));
+                    case 0xdd: return readArray(readBigEndian(4));
+                    case 0xde: return readMap(readBigEndian(2));
+                    case 0xdf: return readMap(readBigEndian(4));
+                    default: break;
+                }
+
+                throw std::runtime_error("msgpack: unsupported type " + std::to_string(type));
+            }
+        };
+    }
+
+    inline std::string encode(const choc::value::ValueView& v) {
+        std::string out;
+        detail::encode(out, v);
+        return out;
+    }
+
+    // Appending forms, for writing a message piece by piece into a reused buffer
+    inline void append(std::string& out, const choc::value::ValueView& v) { detail::encode(out, v); }
+    inline void appendInt(std::string& out, int64_t i) { detail::writeInt(out, i); }
+    inline void appendString(std::string& out, std::string_view s) { detail::writeString(out, s); }
+    inline void appendArrayHeader(std::string& out, size_t size) { detail::writeHeader(out, size, 0x90, 15, 0, 0xdc, 0xdd); }
+    inline void appendMapHeader(std::string& out, size_t size) { detail::writeHeader(out, size, 0x80, 15, 0, 0xde, 0xdf); }
+
+    inline choc::value::Value decode(std::string_view data) {
+        detail::Reader reader {data};
+        return reader.read();
+    }
+}
@@ -0,0 +1,564 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+
+namespace imagiro
+{
+    // HTTP + WebSocket server on Boost.Beast, in the shape of choc's HTTPServer.
+    // It also passes request headers through, lets a client set the response
+    // status and headers, sends binary frames, and can close a client's socket,
+    // none of which choc's server exposes.
+    class SocketServer
+    {
+        class WebSocketSession;
+        struct State;
+
+    public:
+        struct Request
+        {
+            std::string method;
+            std::string target; // path plus any query string
+            std::vector<std::pair<std::string, std::string>> headers;
+
+            // Empty if the header wasn't sent. Names compare case-insensitively.
+            std::string_view getHeader(std::string_view name) const
+            {
+                for (const auto& [headerName, value] : headers)
+                {
+                    const auto sameName = std::equal(headerName.begin(), headerName.end(), name.begin(), name.end(),
+                                                     [](char a, char b)
+                                                     {
+                                                         return std::tolower(static_cast<unsigned char>(a))
+                                                                == std::tolower(static_cast<unsigned char>(b));
+                                                     });
+                    if (sameName) return value;
+                }
+                return {};
+            }
+
+            std::string_view getPath() const
+            {
+                return std::string_view(target).substr(0, target.find('?'));
+            }
+        };
+
+        struct Response
+        {
+            unsigned status = 404;
+            std::string contentType;
+            std::vector<std::pair<std::string, std::string>> headers;
+            std::string body;
+        };
+
+        // One per TCP connection. A client whose connection is upgraded stays
+        // alive, owned by its session, until the socket closes.
+        class Client
+        {
+        public:
+            virtual ~Client() = default;
+
+            virtual Response handleHTTPRequest(const Request&) = 0;
+            virtual void upgradedToWebSocket(std::string_view /*target*/) {}
+            virtual void handleWebSocketMessage(std::string_view message, bool isBinary) = 0;
+
+            // Blocks until the frame is written, or returns false once the socket closes.
+            // Only one send should be in flight per client.
+            bool sendWebSocketMessage(std::shared_ptr<const std::string> message, bool isBinary = false);
+
+            // Drops the connection without a close handshake, so it also works on a
+            // client that has stopped reading. Any send in progress returns false.
+            void closeWebSocket();
+
+            bool isWebSocketOpen() const;
+
+        private:
+            friend class SocketServer;
+            mutable std::mutex sessionLock;
+            std::weak_ptr<WebSocketSession> session;
+            std::shared_ptr<State> serverState;
+        };
+
+        using CreateClientFn = std::function<std::shared_ptr<Client>()>;
+        using HandleErrorFn = std::function<void(const std::string&)>;
+
+        SocketServer() = default;
+        ~SocketServer() { close(); }
+
+        bool open(const std::string& address, uint16_t port, uint32_t numThreads,
+                  CreateClientFn createClient, HandleErrorFn handleError)
+        {
+            close();
+            state = std::make_shared<State>();
+            createClientFn = std::move(createClient);
+            handleErrorFn = std::move(handleError);
+
+            try
+            {
+                const tcp::endpoint endpoint(boost::asio::ip::make_address(address), port);
+                acceptor.open(endpoint.protocol());
+                acceptor.set_option(boost::asio::socket_base::reuse_address(true));
+                acceptor.bind(endpoint);
+                acceptor.listen(boost::asio::socket_base::max_listen_connections);
+                boundAddress = address;
+                boundPort = acceptor.local_endpoint().port();
+            }
+            catch (const std::exception& e)
+            {
+                boost::beast::error_code ec;
+                acceptor.close(ec);
+                if (handleErrorFn) handleErrorFn(e.what());
+                return false;
+            }
+
+            accept();
+            for (uint32_t i = 0; i < std::max(1u, numThreads); i++)
+            {
+                threads.emplace_back([this] { ioContext.run(); });
+            }
+            return true;
+        }
+
+        // Closes every connection, waits for any send in progress to give up, and
+        // stops the network threads. Sends attempted afterwards fail straight away.
+        void close()
+        {
+            std::vector<std::shared_ptr<Session>> sessions;
+            {
+                std::lock_guard l(state->lock);
+                state->closing = true;
+                for (const auto& session : state->sessions)
+                {
+                    if (auto s = session.lock()) sessions.push_back(std::move(s));
+                }
+                state->sessions.clear();
+            }
+
+            for (const auto& session : sessions) session->close();
+            sessions.clear();
+
+            if (threads.empty())
+            {
+                boost::beast::error_code ec;
+                acceptor.close(ec);
+            }
+            else
+            {
+                boost::asio::post(ioContext, [this]
+                {
+                    boost::beast::error_code ec;
+                    acceptor.close(ec);
+                });
+            }
+
+            // senders notice the closed sessions within one poll interval
+            {
+                std::unique_lock l(state->lock);
+                state->sendsDone.wait(l, [this] { return state->sendsInFlight == 0; });
+            }
+
+            // with every socket closed the handlers complete and run() returns by
+            // itself; anything still pending after that is abandoned
+            for (int i = 0; i < 100 && !threads.empty() && !ioContext.stopped(); i++)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            ioContext.stop();
+            for (auto& t : threads) t.join();
+            threads.clear();
+            ioContext.restart();
+        }
+
+        std::string getWebSocketAddress() const
+        {
+            return "ws://" + boundAddress + ":" + std::to_string(boundPort);
+        }
+
+    private:
+        using tcp = boost::asio::ip::tcp;
+
+        struct PendingWrite
+        {
+            std::shared_ptr<const std::string> message;
+            bool binary;
+            std::promise<bool> written;
+        };
+
+        static std::string toString(boost::beast::string_view s) { return {s.data(), s.size()}; }
+
+        struct Session
+        {
+            virtual ~Session() = default;
+            virtual void close() = 0;
+        };
+
+        // Shared by the server, its sessions and their clients. Sends are counted
+        // here so close() can wait for them, and none start once it's closing, so
+        // nothing is posted to the io_context after it has stopped.
+        struct State
+        {
+            std::mutex lock;
+            std::condition_variable sendsDone;
+            bool closing = false;
+            int sendsInFlight = 0;
+            std::vector<std::weak_ptr<Session>> sessions;
+
+            bool addSession(std::weak_ptr<Session> session)
+            {
+                std::lock_guard l(lock);
+                if (closing) return false;
+                std::erase_if(sessions, [](const std::weak_ptr<Session>& s) { return s.expired(); });
+                sessions.push_back(std::move(session));
+                return true;
+            }
+
+            bool beginSend()
+            {
+                std::lock_guard l(lock);
+                if (closing) return false;
+                sendsInFlight++;
+                return true;
+            }
+
+            void endSend()
+            {
+                {
+                    std::lock_guard l(lock);
+                    sendsInFlight--;
+                }
+                sendsDone.notify_all();
+            }
+        };
+
+        class WebSocketSession : public Session, public std::enable_shared_from_this<WebSocketSession>
+        {
+        public:
+            WebSocketSession(tcp::socket&& socket, std::shared_ptr<Client> c, std::shared_ptr<State> s)
+                : ws(std::move(socket)), client(std::move(c)), serverState(std::move(s))
+            {
+            }
+
+            void run(boost::beast::http::request<boost::beast::http::string_body>&& request)
+            {
+                upgradeRequest = std::move(request);
+                ws.set_option(boost::beast::websocket::stream_base::timeout::suggested(boost::beast::role_type::server));
+                ws.async_accept(upgradeRequest, [self = shared_from_this()](boost::beast::error_code ec)
+                {
+                    if (ec) return;
+                    {
+                        std::lock_guard l(self->client->sessionLock);
+                        self->client->session = self;
+                        self->client->serverState = self->serverState;
+                    }
+                    self->open = true;
+                    self->client->upgradedToWebSocket(toString(self->upgradeRequest.target()));
+                    self->read();
+                });
+            }
+
+            bool send(std::shared_ptr<const std::string> message, bool binary)
+            {
+                if (!open) return false;
+
+                auto pending = std::make_shared<PendingWrite>();
+                pending->message = std::move(message);
+                pending->binary = binary;
+                auto written = pending->written.get_future();
+
+                boost::asio::post(ws.get_executor(), [self = shared_from_this(), pending]
+                {
+                    if (!self->open)
+                    {
+                        pending->written.set_value(false);
+                        return;
+                    }
+                    self->writeQueue.push_back(pending);
+                    if (self->writeQueue.size() == 1) self->writeNext();
+                });
+
+                // the socket can close, or the server stop, with the write still queued
+                while (written.wait_for(std::chrono::milliseconds(50)) != std::future_status::ready)
+                {
+                    if (!open) return false;
+                }
+
+                try
+                {
+                    return written.get();
+                }
+                catch (const std::future_error&)
+                {
+                    return false;
+                }
+            }
+
+            void close() override
+            {
+                open = false;
+                boost::asio::post(ws.get_executor(), [self = shared_from_this()]
+                {
+                    boost::beast::error_code ec;
+                    auto& stream = boost::beast::get_lowest_layer(self->ws);
+                    stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+                    stream.close();
+                });
+            }
+
+            bool isOpen() const { return open; }
+
+            // A sender holding the last reference would destroy the client from its
+            // own writer thread, so references taken outside the server are dropped on it
+            static void release(std::shared_ptr<WebSocketSession>&& session)
+            {
+                auto executor = session->ws.get_executor();
+                boost::asio::post(executor, [s = std::move(session)] {});
+            }
+
+        private:
+            boost::beast::websocket::stream<boost::beast::tcp_stream> ws;
+            boost::beast::http::request<boost::beast::http::string_body> upgradeRequest;
+            boost::beast::flat_buffer buffer;
+            std::shared_ptr<Client> client;
+            std::shared_ptr<State> serverState;
+            std::deque<std::shared_ptr<PendingWrite>> writeQueue;
+            std::atomic<bool> open {false};
+
+            void read()
+            {
+                ws.async_read(buffer, [self = shared_from_this()](boost::beast::error_code ec, std::size_t)
+                {
+                    if (ec)
+                    {
+                        self->open = false;
+                        return;
+                    }
+
+                    const auto data = static_cast<const char*>(self->buffer.data().data());
+                    self->client->handleWebSocketMessage({data, self->buffer.size()}, self->ws.got_binary());
+                    self->buffer.consume(self->buffer.size());
+                    self->read();
+                });
+            }
+
+            void writeNext()
+            {
+                const auto& next = writeQueue.front();
+                ws.binary(next->binary);
+                ws.async_write(boost::asio::buffer(*next->message),
+                               [self = shared_from_this()](boost::beast::error_code ec, std::size_t)
+                {
+                    auto done = std::move(self->writeQueue.front());
+                    self->writeQueue.pop_front();
+                    done->written.set_value(!ec);
+
+                    if (ec)
+                    {
+                        self->open = false;
+                        for (auto& pending : self->writeQueue) pending->written.set_value(false);
+                        self->writeQueue.clear();
+                        return;
+                    }
+
+                    if (!self->writeQueue.empty()) self->writeNext();
+                });
+            }
+        };
+
+        class HTTPSession : public Session, public std::enable_shared_from_this<HTTPSession>
+        {
+        public:
+            HTTPSession(tcp::socket&& socket, std::shared_ptr<Client> c, std::shared_ptr<State> s)
+                : stream(std::move(socket)), client(std::move(c)), serverState(std::move(s))
+            {
+            }
+
+            void close() override
+            {
+                boost::asio::post(stream.get_executor(), [self = shared_from_this()]
+                {
+                    boost::beast::error_code ec;
+                    self->stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+                    self->stream.close();
+                });
+            }
+
+            void read()
+            {
+                request = {};
+                stream.expires_after(std::chrono::seconds(30));
+                boost::beast::http::async_read(stream, buffer, request,
+                                               [self = shared_from_this()](boost::beast::error_code ec, std::size_t)
+                {
+                    self->handleRequest(ec);
+                });
+            }
+
+        private:
+            boost::beast::tcp_stream stream;
+            boost::beast::flat_buffer buffer;
+            boost::beast::http::request<boost::beast::http::string_body> request;
+            std::shared_ptr<Client> client;
+            std::shared_ptr<State> serverState;
+
+            void handleRequest(boost::beast::error_code ec)
+            {
+                namespace http = boost::beast::http;
+
+                if (ec == http::error::end_of_stream)
+                {
+                    stream.socket().shutdown(tcp::socket::shutdown_send, ec);
+                    return;
+                }
+                if (ec) return;
+
+                if (boost::beast::websocket::is_upgrade(request))
+                {
+                    stream.expires_never();
+                    auto session = std::make_shared<WebSocketSession>(stream.release_socket(), std::move(client), serverState);
+                    if (serverState->addSession(session)) session->run(std::move(request));
+                    return;
+                }
+
+                Request r;
+                r.method = toString(request.method_string());
+                r.target = toString(request.target());
+                for (const auto& field : request)
+                {
+                    r.headers.emplace_back(toString(field.name_string()), toString(field.value()));
+                }
+
+                Response response;
+                try
+                {
+                    response = client->handleHTTPRequest(r);
+                }
+                catch (...)
+                {
+                    response = {};
+                    response.status = 500;
+                }
+
+                auto res = std::make_shared<http::response<http::string_body>>(
+                    static_cast<http::status>(response.status), request.version());
+                if (!response.contentType.empty()) res->set(http::field::content_type, response.contentType);
+                for (const auto& [name, value] : response.headers) res->set(name, value);
+                res->keep_alive(request.keep_alive());
+
+                if (request.method() == http::verb::head)
+                {
+                    res->content_length(response.body.size());
+                }
+                else
+                {
+                    res->body() = std::move(response.body);
+                    res->prepare_payload();
+                }
+
+                http::async_write(stream, *res, [self = shared_from_this(), res](boost::beast::error_code writeError, std::size_t)
+                {
+                    if (writeError) return;
+                    if (!res->keep_alive())
+                    {
+                        self->stream.socket().shutdown(tcp::socket::shutdown_send, writeError);
+                        return;
+                    }
+                    self->read();
+                });
+            }
+        };
+
+        // Declared first so it outlives the io_context: sessions torn down with the
+        // context's handlers still refer to it
+        std::shared_ptr<State> state = std::make_shared<State>();
+        boost::asio::io_context ioContext;
+        tcp::acceptor acceptor {ioContext};
+        std::vector<std::thread> threads;
+        CreateClientFn createClientFn;
+        HandleErrorFn handleErrorFn;
+        std::string boundAddress;
+        uint16_t boundPort {0};
+
+        void accept()
+        {
+            acceptor.async_accept(boost::asio::make_strand(ioContext), [this](boost::beast::error_code ec, tcp::socket socket)
+            {
+                if (ec == boost::asio::error::operation_aborted) return;
+
+                if (ec)
+                {
+                    if (handleErrorFn) handleErrorFn(ec.message());
+                }
+                else if (auto client = createClientFn ? createClientFn() : nullptr)
+                {
+                    auto session = std::make_shared<HTTPSession>(std::move(socket), std::move(client), state);
+                    if (!state->addSession(session)) return;
+                    session->read();
+                }
+
+                accept();
+            });
+        }
+    };
+
+    inline bool SocketServer::Client::sendWebSocketMessage(std::shared_ptr<const std::string> message, bool isBinary)
+    {
+        std::shared_ptr<State> state;
+        {
+            std::lock_guard l(sessionLock);
+            state = serverState;
+        }
+        if (!state || !state->beginSend()) return false;
+
+        std::shared_ptr<WebSocketSession> s;
+        {
+            std::lock_guard l(sessionLock);
+            s = session.lock();
+        }
+
+        auto sent = false;
+        if (s)
+        {
+            sent = s->send(std::move(message), isBinary);
+            WebSocketSession::release(std::move(s));
+        }
+        state->endSend();
+        return sent;
+    }
+
+    // These run on the caller's own thread (never a client's writer), so the last
+    // reference to a session can be dropped there, and nothing is posted once the
+    // session has gone
+    inline void SocketServer::Client::closeWebSocket()
+    {
+        std::shared_ptr<WebSocketSession> s;
+        {
+            std::lock_guard l(sessionLock);
+            s = session.lock();
+        }
+        if (s) s->close();
+    }
+
+    inline bool SocketServer::Client::isWebSocketOpen() const
+    {
+        std::shared_ptr<WebSocketSession> s;
+        {
+            std::lock_guard l(sessionLock);
+            s = session.lock();
+        }
+        return s && s->isOpen();
+    }
+}
@@ -3,82 +3,391 @@
 //
 
 #pragma once
-#include <choc/network/choc_HTTPServer.h>
 #include <juce_core/juce_core.h>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <unordered_set>
 
 #include "UIConnection.h"
+#include "EvalQueue.h"
+#include "MessagePack.h"
+#include "SocketServer.h"
 #include "../AssetServer/AssetServer.h"
 
 
 namespace imagiro
 {
-    struct ClientInstance : public choc::network::HTTPServer::ClientInstance
+    // Limits on how far a client's outbound queue may fall behind. Over the byte
+    // budget, the oldest broadcast messages are shed. Once the oldest queued
+    // message is older than the latency budget, the client's broadcast backlog is
+    // dropped and it's resynced when it catches up. A client stuck on a single
+    // frame for twice the latency budget has stopped reading and is disconnected.
+    struct ClientBudget
     {
-        ClientInstance(AssetServer& s, std::unordered_map<std::string, UIConnection::CallbackFn>& fns)
-            : functions(fns), assetServer(s)
+        size_t maxQueuedBytes = 4 * 1024 * 1024;
+        uint32_t maxLatencyMs = 3000;
+    };
+
+    // Wire format for a socket client, chosen when it connects by adding
+    // ?codec=msgpack to the websocket URL. JSON goes over text frames and msgpack
+    // over binary frames. JSON stays the default for debugging.
+    //
+    // Binary events (evalBinary) skip both: they go to either codec as a binary
+    // frame of 0xc1, one byte of event name length, the event name, then the raw
+    // payload. 0xc1 is never used by msgpack, so msgpack clients can tell the two
+    // apart from the first byte. Legacy evaluate clients get base64 instead.
+    enum class SocketCodec
+    {
+        json,
+        msgpack
+    };
+
+    struct ClientInstance : public SocketServer::Client,
+                            public std::enable_shared_from_this<ClientInstance>
+    {
+        // Called on a network thread once the connection is upgraded. Plain HTTP
+        // asset requests get a client too, but only upgraded ones count as a UI.
+        using UpgradedFn = std::function<void(std::shared_ptr<ClientInstance>)>;
+
+        ClientInstance(AssetServer& s, UIConnection& c, juce::ThreadPool& pool, ClientBudget b, UpgradedFn upgraded)
+            : connection(c), assetServer(s), backgroundPool(pool), budget(b), onUpgraded(std::move(upgraded))
         {
         }
 
         ~ClientInstance() override
         {
+            // the writer may be blocked mid-send, closing the socket releases it
+            closeWebSocket();
+            {
+                std::lock_guard l(outboundLock);
+                stopWriter = true;
+            }
+            outboundReady.notify_one();
+            if (writer.joinable()) writer.join();
         }
 
-        choc::network::HTTPContent getHTTPContent(std::string_view requestedPath) override
+        // Queues a message for this client's writer thread. Broadcasts share one
+        // buffer across all clients; droppable messages may be shed if the client
+        // falls behind. Binary messages go out as binary frames whatever the codec.
+        // Returns false if the client isn't accepting messages.
+        bool enqueueOutbound(std::shared_ptr<const std::string> message, bool droppable = true,
+                             bool binary = false)
         {
-            choc::network::HTTPContent content;
-            auto resource = assetServer.getResource(requestedPath);
-            if (!resource) return content;
+            if (!upgraded) return false;
+
+            const auto now = juce::Time::getMillisecondCounter();
+            std::lock_guard l(outboundLock);
+
+            if (!catchingUp && !outbound.empty() && now - outbound.front().enqueuedAt > budget.maxLatencyMs)
+            {
+                DBG("websocket client fell behind, dropping its backlog");
+                std::erase_if(outbound, [this](const OutboundMessage& m)
+                {
+                    if (m.droppable) outboundBytes -= m.message->size();
+                    return m.droppable;
+                });
+                catchingUp = true;
+            }
+
+            // broadcasts are pointless until the client catches up, the resync
+            // that follows replaces them
+            if (catchingUp && droppable) return false;
+
+            outboundBytes += message->size();
+            outbound.push_back({std::move(message), now, droppable, binary});
+
+            for (auto it = outbound.begin(); outboundBytes > budget.maxQueuedBytes && it != outbound.end();)
+            {
+                if (!it->droppable) { ++it; continue; }
+                outboundBytes -= it->message->size();
+                it = outbound.erase(it);
+                droppedMessages = true;
+            }
 
-            content.mimeType = resource->mimeType;
-            content.content = std::string(resource->data.begin(), resource->data.end());
-            return content;
+            outboundReady.notify_one();
+            return true;
         }
 
-        void handleWebSocketMessage(const std::string_view messageString) override
+        // False once the connection has gone. A client whose writer has been stuck
+        // on one frame for too long has stopped reading, so it's closed here.
+        // A client that only lags has its backlog dropped and is resynced instead.
+        // State is broadcast, so that resync goes to every client, not just this one.
+        bool checkConnection()
+        {
+            if (sending && juce::Time::getMillisecondCounter() - sendStartedAt > 2 * budget.maxLatencyMs)
+            {
+                DBG("websocket client stopped reading, closing it");
+                closeWebSocket();
+                return false;
+            }
+            return isWebSocketOpen();
+        }
+
+        // Clients that never subscribed receive every event; once a client
+        // subscribes it only receives its topics plus untopiced events
+        bool wantsTopic(const std::string& topic)
+        {
+            if (topic.empty()) return true;
+            std::lock_guard l(subscriptionsLock);
+            return !hasSubscribed || subscriptions.contains(topic);
+        }
+        SocketCodec getCodec() const { return codec; }
+
+        // Clients from before structured events connect without protocol=2 in the
+        // URL. For one more release they're still sent each call as JS source
+        // (type 3, Evaluate); msgpack clients always get events.
+        bool wantsLegacyEvaluate() const { return legacyEvaluate; }
+
+        static std::string encodeMessage(SocketCodec c, const choc::value::ValueView& message)
+        {
+            return c == SocketCodec::msgpack ? msgpack::encode(message) : choc::json::toString(message);
+        }
+
+        // The frame type says which format a message is in, whatever codec was negotiated
+        static choc::value::Value decodeMessage(std::string_view message, bool isBinary)
+        {
+            return isBinary ? msgpack::decode(message) : choc::json::parse(message);
+        }
+
+        // True once after this client had to shed messages, so its state needs resending
+        bool takeDroppedMessages() { return droppedMessages.exchange(false); }
+
+        SocketServer::Response handleHTTPRequest(const SocketServer::Request& httpRequest) override
+        {
+            SocketServer::Response response;
+
+            AssetServer::Request request;
+            request.path = httpRequest.getPath();
+            request.acceptEncoding = httpRequest.getHeader("Accept-Encoding");
+            request.ifNoneMatch = httpRequest.getHeader("If-None-Match");
+            request.range = httpRequest.getHeader("Range");
+            auto resource = assetServer.getResource(request);
+            if (!resource) return response;
+
+            if (resource->notModified) response.status = 304;
+            else if (resource->rangeNotSatisfiable) response.status = 416;
+            else if (resource->partial) response.status = 206;
+            else response.status = 200;
+
+            if (resource->partial || resource->rangeNotSatisfiable)
+                response.headers.push_back({"Content-Range", resource->getContentRange()});
+            response.headers.push_back({"Accept-Ranges", "bytes"});
+
+            response.contentType = resource->mimeType;
+            if (!resource->contentEncoding.empty())
+                response.headers.push_back({"Content-Encoding", resource->contentEncoding});
+            // the body depends on Accept-Encoding, so caches have to key on it
+            response.headers.push_back({"Vary", "Accept-Encoding"});
+            if (!resource->etag.empty()) response.headers.push_back({"ETag", resource->etag});
+            if (!resource->cacheControl.empty()) response.headers.push_back({"Cache-Control", resource->cacheControl});
+
+            // the response owns its body as a string, so this is the one copy the socket path makes
+            response.body.assign(reinterpret_cast<const char*>(resource->data.data()), resource->data.size());
+            return response;
+        }
+
+        void handleWebSocketMessage(std::string_view messageString, bool isBinary) override
         {
             try
             {
-                const auto message = choc::json::parse(messageString);
+                const auto message = decodeMessage(messageString, isBinary);
                 auto id = std::string(message["id"].getWithDefault(""));
-                auto functionName = std::string(message["functionName"].getWithDefault(""));
                 auto args = choc::value::Value(message["args"]);
 
-                // Capture necessary data and dispatch to message thread
-                juce::MessageManager::callAsync([this, id, functionName, args]()
+                if (handleSubscriptionMessage(id, message, args)) return;
+
+                // Calls carry either the interned function ID (see juce_getFunctionTable)
+                // or, from older clients, the function name
+                std::optional<UIConnection::FunctionID> fnID;
+                std::string functionName;
+                if (message.hasObjectMember("fnID"))
+                {
+                    fnID = static_cast<UIConnection::FunctionID>(message["fnID"].getWithDefault(-1));
+                }
+                else
                 {
-                    auto resultMessage = choc::value::createObject("Message");
-                    resultMessage.addMember("type", 1);
-                    resultMessage.addMember("id", id);
+                    functionName = std::string(message["functionName"].getWithDefault(""));
+                    fnID = connection.getFunctionID(functionName);
+                }
 
-                    const auto function = functions.find(functionName);
-                    if (function == functions.end())
-                    {
-                        resultMessage.setMember("type", 2);
-                        resultMessage.addMember("result", "unable to find function " + std::string(functionName));
-                    }
-                    else
-                    {
-                        auto result = function->second(args);
-                        resultMessage.addMember("result", result);
-                    }
+                // Run the call on the lane it was bound with. The client may have
+                // disconnected by the time a deferred call runs.
+                auto call = [weakThis = weak_from_this(), id, fnID, functionName, args]()
+                {
+                    if (auto client = weakThis.lock())
+                        client->callAndRespond(id, fnID, functionName, args);
+                };
 
-                    sendWebSocketMessage(choc::json::toString(resultMessage));
-                });
+                switch (fnID ? connection.getFunctionThread(*fnID) : UIConnection::CallThread::message)
+                {
+                    case UIConnection::CallThread::any:
+                        call();
+                        break;
+                    case UIConnection::CallThread::background:
+                        backgroundPool.addJob(std::move(call));
+                        break;
+                    case UIConnection::CallThread::message:
+                        juce::MessageManager::callAsync(std::move(call));
+                        break;
+                }
             }
             catch (const choc::value::Error& e)
             {
                 DBG("Error handling WebSocket message: " << e.what());
             }
+            catch (const std::exception& e)
+            {
+                DBG("Error handling WebSocket message: " << e.what());
+            }
+            catch (...)
+            {
+                DBG("Error handling WebSocket message");
+            }
         }
 
         void upgradedToWebSocket(std::string_view path) override
         {
             DBG("opened websocket for path " << std::string(path));
+            if (path.find("codec=msgpack") != std::string_view::npos) codec = SocketCodec::msgpack;
+            legacyEvaluate = codec == SocketCodec::json && path.find("protocol=2") == std::string_view::npos;
+            writer = std::thread([this] { runWriter(); });
+            upgraded = true;
+            if (onUpgraded) onUpgraded(shared_from_this());
         }
 
     private:
-        std::unordered_map<std::string, UIConnection::CallbackFn>& functions;
+        UIConnection& connection;
         AssetServer& assetServer;
+        juce::ThreadPool& backgroundPool;
+        const ClientBudget budget;
+        UpgradedFn onUpgraded;
+
+        struct OutboundMessage
+        {
+            std::shared_ptr<const std::string> message;
+            uint32_t enqueuedAt;
+            bool droppable;
+            bool binary;
+        };
+
+        std::mutex outboundLock;
+        std::condition_variable outboundReady;
+        std::deque<OutboundMessage> outbound;
+        size_t outboundBytes {0};
+        bool stopWriter {false};
+        std::thread writer;
+
+        std::atomic<SocketCodec> codec {SocketCodec::json};
+        std::atomic<bool> upgraded {false};
+        std::atomic<bool> legacyEvaluate {false};
+        std::atomic<bool> droppedMessages {false};
+        std::atomic<bool> sending {false};
+        std::atomic<uint32_t> sendStartedAt {0};
+        bool catchingUp {false};
+
+        // sendWebSocketMessage blocks until the frame is written, so each client
+        // gets its own writer and a slow one can't hold up the others
+        void runWriter()
+        {
+            std::unique_lock l(outboundLock);
+            while (!stopWriter)
+            {
+                outboundReady.wait(l, [this] { return stopWriter || !outbound.empty(); });
+
+                while (!stopWriter && !outbound.empty())
+                {
+                    auto next = std::move(outbound.front());
+                    outbound.pop_front();
+                    outboundBytes -= next.message->size();
+
+                    sendStartedAt = juce::Time::getMillisecondCounter();
+                    sending = true;
+                    l.unlock();
+                    sendWebSocketMessage(std::move(next.message), next.binary || codec == SocketCodec::msgpack);
+                    l.lock();
+                    sending = false;
+                }
+
+                // a client that had its backlog dropped gets resent everything once it's drained
+                if (catchingUp && outbound.empty())
+                {
+                    catchingUp = false;
+                    droppedMessages = true;
+                }
+            }
+        }
+
+        std::mutex subscriptionsLock;
+        std::unordered_set<std::string> subscriptions;
+        bool hasSubscribed {false};
+
+        // juce_subscribe / juce_unsubscribe take a list of event topics and apply
+        // to this client only, so they're handled here rather than bound
+        bool handleSubscriptionMessage(const std::string& id, const choc::value::ValueView& message,
+                                       const choc::value::ValueView& topics)
+        {
+            const auto functionName = message["functionName"].getWithDefault("");
+            const bool subscribe = functionName == std::string_view("juce_subscribe");
+            if (!subscribe && functionName != std::string_view("juce_unsubscribe")) return false;
+
+            {
+                std::lock_guard l(subscriptionsLock);
+                hasSubscribed = true;
+                for (uint32_t i = 0; topics.isArray() && i < topics.size(); i++)
+                {
+                    auto topic = std::string(topics[i].getWithDefault(""));
+                    if (subscribe) subscriptions.insert(topic);
+                    else subscriptions.erase(topic);
+                }
+            }
+
+            auto resultMessage = choc::value::createObject("Message");
+            resultMessage.addMember("type", 1);
+            resultMessage.addMember("id", id);
+            resultMessage.addMember("result", choc::value::Value());
+            enqueueOutbound(std::make_shared<const std::string>(encodeMessage(codec, resultMessage)), false);
+            return true;
+        }
+
+        void callAndRespond(const std::string& id, std::optional<UIConnection::FunctionID> fnID,
+                            const std::string& functionName, const choc::value::Value& args)
+        {
+            auto resultMessage = choc::value::createObject("Message");
+            resultMessage.addMember("type", 1);
+            resultMessage.addMember("id", id);
+
+            if (!fnID || !connection.hasFunction(*fnID))
+            {
+                resultMessage.setMember("type", 2);
+                resultMessage.addMember("result", "unable to find function " + functionName);
+            }
+            else
+            {
+                try
+                {
+                    auto result = connection.callFunction(*fnID, args);
+                    resultMessage.addMember("result", result);
+                }
+                catch (const choc::value::Error& e)
+                {
+                    resultMessage.setMember("type", 2);
+                    resultMessage.addMember("result", std::string(e.what()));
+                }
+                catch (const std::exception& e)
+                {
+                    resultMessage.setMember("type", 2);
+                    resultMessage.addMember("result", std::string(e.what()));
+                }
+                catch (...)
+                {
+                    resultMessage.setMember("type", 2);
+                    resultMessage.addMember("result", "error calling " + functionName);
+                }
+            }
+
+            enqueueOutbound(std::make_shared<const std::string>(encodeMessage(codec, resultMessage)), false);
+        }
     };
 
     class SocketUIConnection : public UIConnection, juce::Timer
@@ -87,17 +396,33 @@ namespace imagiro
         explicit SocketUIConnection(AssetServer& s, const std::string& address = "0.0.0.0", const uint16_t port = 4350)
             : assetServer(s)
         {
-            auto serverPointer = &this->assetServer;
-            auto fnsPointer = &this->boundFunctions;
+            bindBuiltins();
+
+            setEventTopic("updateParameterState", "params");
+            setEventTopic("setParameterTable", "params");
+            setEventTopic("applyParameterSnapshot", "params");
+            setEventTopic("modMatrixUpdated", "modulation");
+            setEventTopic("sourceValueUpdated", "modulation");
+            setEventTopic("targetValueUpdated", "modulation");
+            setEventTopic("onRecentVoiceUpdated", "modulation");
+            setEventTopic("presetChanged", "presets");
+            setEventTopic("reloadPresets", "presets");
+            setEventTopic("presetCategoryLoaded", "presets");
+            setEventTopic("presetFavoriteChanged", "presets");
+
+            // consumers, resyncs and frame listeners all belong to the message thread,
+            // so a new client is only recorded here and picked up by the next tick
             bool openedOk = server.open(address, port, 1,
-                                        [this, serverPointer, fnsPointer]
+                                        [this]
                                         {
-                                            auto client = std::make_shared<ClientInstance>(*serverPointer, *fnsPointer);
-                                            {
-                                                std::lock_guard l(activeClientsLock);
-                                                activeClients.push_back({client});
-                                            }
-                                            return client;
+                                            return std::make_shared<ClientInstance>(
+                                                assetServer, *this, backgroundCalls, clientBudget,
+                                                [this](std::shared_ptr<ClientInstance> client)
+                                                {
+                                                    std::lock_guard l(activeClientsLock);
+                                                    activeClients.push_back(client);
+                                                    clientJoined = true;
+                                                });
                                         },
                                         [](const std::string& error)
                                         {
@@ -115,75 +440,274 @@ namespace imagiro
             startTimerHz(20);
         }
 
-        void bindFunction(const std::string& functionName, CallbackFn&& callback) override
+        // The network threads use the members below (the client budget, the client
+        // list and its lock), so they're stopped before any of those go
+        ~SocketUIConnection() override
         {
-            boundFunctions.insert({functionName, callback});
+            stopTimer();
+            {
+                std::lock_guard l(activeClientsLock);
+                for (const auto& client : activeClients)
+                {
+                    if (auto c = client.lock()) c->closeWebSocket();
+                }
+                activeClients.clear();
+            }
+            server.close();
+            backgroundCalls.removeAllJobs(true, -1);
         }
 
+        // Events are the eval'd function name without the window.ui. prefix. Clients
+        // subscribe to topics, so related events share one.
+        void setEventTopic(const std::string& event, const std::string& topic)
+        {
+            eventTopics[event] = topic;
+        }
+
+        // Applies to clients that connect after the call
+        void setClientBudget(ClientBudget b) { clientBudget = b; }
+
         void timerCallback() override
         {
-            try
+            // the timer keeps running while idle so connects and disconnects are
+            // noticed, but does nothing beyond that until a client is attached
+            bool clientDroppedMessages = false;
+            bool newClient = false;
             {
-                std::string js;
-                while (jsEvalQueue.try_dequeue(js))
-                {
-                    auto evalMessage = choc::value::createObject("Message");
-                    evalMessage.addMember("type", 3); // 3 = Evaluate
-                    evalMessage.addMember("js", js);
-
-                    const auto evalString = choc::json::toString(evalMessage);
+                std::lock_guard l(activeClientsLock);
+                newClient = std::exchange(clientJoined, false);
 
-                    std::lock_guard l(activeClientsLock);
+                std::erase_if(activeClients, [](const std::weak_ptr<ClientInstance>& client)
+                {
+                    auto c = client.lock();
+                    return !c || !c->checkConnection();
+                });
 
-                    std::erase_if(activeClients, [](const std::weak_ptr<ClientInstance>& client)
-                    {
-                        return client.expired();
-                    });
+                if (activeClients.empty())
+                {
+                    setHasConsumers(false);
+                    messageQueue.clear();
+                    return;
+                }
 
-                    for (const auto& client : activeClients)
+                clientsToSend.clear();
+                for (const auto& client : activeClients)
+                {
+                    if (auto c = client.lock())
                     {
-                        if (auto c = client.lock()) c->sendWebSocketMessage(evalString);
+                        if (c->takeDroppedMessages()) clientDroppedMessages = true;
+                        clientsToSend.push_back(std::move(c));
                     }
                 }
             }
-            catch (choc::value::Error& e)
+
+            bool jsonInUse = false, msgpackInUse = false;
+            for (const auto& client : clientsToSend)
+            {
+                (client->getCodec() == SocketCodec::msgpack ? msgpackInUse : jsonInUse) = true;
+            }
+            jsonClients = jsonInUse;
+            msgpackClients = msgpackInUse;
+
+            // whatever was queued before the first client attached is stale, the
+            // resync that follows sends current state instead
+            const bool queueDroppedMessages = messageQueue.takeDropped();
+            const bool resyncing = !hasConsumers() || newClient || clientDroppedMessages || queueDroppedMessages;
+            if (!hasConsumers())
             {
-                DBG(e.what());
+                messageQueue.clear();
+                setHasConsumers(true);
+            }
+            // a client that joins late, or messages shed by a client or by the
+            // full queue, leave clients missing state, so resend everything
+            else if (resyncing)
+            {
+                requestResync();
+            }
+
+            notifyFrameStarting();
+
+            // drops caused by the resync itself are ignored, or one too big for
+            // the queue would repeat every tick
+            if (resyncing) messageQueue.takeDropped();
+
+            // queued messages hold the encodings the connected clients use. Each
+            // shared buffer is built once per codec and queued on every client.
+            while (messageQueue.pop(outgoingMessage))
+            {
+                const auto topic = eventTopics.find(outgoingMessage.functionName);
+                const auto& topicName = topic != eventTopics.end() ? topic->second : noTopic;
+
+                // one buffer each for JSON events, msgpack events and legacy evaluates.
+                // Binary frames are the same for both codecs.
+                const bool binary = isBinaryFrame(outgoingMessage);
+                std::shared_ptr<const std::string> encoded[3];
+                for (const auto& client : clientsToSend)
+                {
+                    if (!client->wantsTopic(topicName)) continue;
+
+                    const auto codec = client->getCodec();
+                    const auto legacy = client->wantsLegacyEvaluate();
+                    auto& message = encoded[legacy ? 2 : binary ? 0 : static_cast<size_t>(codec)];
+                    if (!message)
+                    {
+                        message = std::make_shared<const std::string>(legacy ? getLegacyEvaluate(outgoingMessage)
+                                                                      : binary ? outgoingMessage.packedPayload
+                                                                               : getEncoded(outgoingMessage, codec));
+                    }
+
+                    client->enqueueOutbound(message, true, binary && !legacy);
+                }
             }
+
+            clientsToSend.clear();
         }
 
         void evalFunction(const std::string& functionName, const std::vector<choc::value::Value>& args) override
         {
-            try
+            // sent as a structured event rather than JS source, so clients don't
+            // need to eval anything. Written straight into per-thread buffers that
+            // keep their capacity; push() copies them into the queue's slots.
+            const auto event = getEventName(functionName);
+
+            thread_local std::string key, json, packed;
+            key.clear();
+            json.clear();
+            packed.clear();
+            appendEvalKey(key, functionName, args);
+
+            if (jsonClients || !msgpackClients)
             {
-                auto js = functionName + "(";
-                for (auto i = 0u; i < args.size(); i++)
+                json += "{\"type\":5,\"event\":"; // 5 = Event
+                appendQuoted(json, event);
+                json += ",\"args\":[";
+                for (size_t i = 0; i < args.size(); i++)
                 {
-                    js += choc::json::toString(args[i]);
-                    if (i != args.size() - 1) js += ",";
+                    if (i > 0) json += ",";
+                    appendJSON(json, args[i]);
                 }
-                js += ");";
+                json += "]}";
+            }
 
-                jsEvalQueue.enqueue(js);
+            if (msgpackClients)
+            {
+                msgpack::appendMapHeader(packed, 3);
+                msgpack::appendString(packed, "type");
+                msgpack::appendInt(packed, 5);
+                msgpack::appendString(packed, "event");
+                msgpack::appendString(packed, event);
+                msgpack::appendString(packed, "args");
+                msgpack::appendArrayHeader(packed, args.size());
+                for (const auto& arg : args) msgpack::append(packed, arg);
             }
-            catch (choc::value::Error& e)
+
+            messageQueue.push(key, event, json, packed);
+        }
+
+        void evalBinaryFunction(const std::string& functionName, const void* data, size_t size) override
+        {
+            // sent as is in a binary frame (see SocketCodec), the queued frame
+            // lives in packedPayload
+            const auto event = getEventName(functionName);
+            if (event.size() > 255)
             {
-                DBG("E" + juce::String(e.what()));
-                for (auto i = 0u; i < args.size(); i++)
-                {
-                    DBG(args[i].toString());
-                }
+                jassertfalse;
+                return;
             }
+
+            thread_local std::string frame;
+            frame.clear();
+            frame += binaryFrameMarker;
+            frame += static_cast<char>(event.size());
+            frame += event;
+            frame.append(static_cast<const char*>(data), size);
+
+            messageQueue.push(functionName, event, {}, frame);
         }
 
+        EvalQueue& getEvalQueue() { return messageQueue; }
+
     private:
-        choc::network::HTTPServer server;
+        juce::ThreadPool backgroundCalls {2};
+        SocketServer server;
         AssetServer& assetServer;
 
 
-        moodycamel::ConcurrentQueue<std::string> jsEvalQueue{512};
+        EvalQueue messageQueue{512, EvalQueue::OverflowPolicy::coalesceByKey};
+        EvalQueue::Message outgoingMessage;
+
+        ClientBudget clientBudget;
+
+        std::unordered_map<std::string, std::string> eventTopics;
+        const std::string noTopic;
+
+        // Set each tick from the connected clients. Messages are only encoded in the
+        // formats in use; one queued before a client with another codec connected
+        // gets converted when it's sent.
+        std::atomic<bool> jsonClients {true};
+        std::atomic<bool> msgpackClients {false};
+
+        static constexpr char binaryFrameMarker = static_cast<char>(0xc1);
+
+        static bool isBinaryFrame(const EvalQueue::Message& message)
+        {
+            return message.payload.empty() && !message.packedPayload.empty()
+                && message.packedPayload.front() == binaryFrameMarker;
+        }
+
+        static std::string getEncoded(const EvalQueue::Message& message, SocketCodec codec)
+        {
+            if (codec == SocketCodec::msgpack)
+            {
+                return !message.packedPayload.empty() ? message.packedPayload
+                                                      : msgpack::encode(choc::json::parse(message.payload));
+            }
+            return !message.payload.empty() ? message.payload
+                                            : choc::json::toString(msgpack::decode(message.packedPayload));
+        }
+
+        // The event rebuilt as the window.ui call older clients eval. Only built when
+        // one of them is connected, so it takes the simple route through choc.
+        static std::string getLegacyEvaluate(const EvalQueue::Message& message)
+        {
+            auto js = "window.ui." + message.functionName + "(";
+            if (isBinaryFrame(message))
+            {
+                // binary events pass their payload as a base64 string
+                const size_t headerSize = 2 + static_cast<uint8_t>(message.packedPayload[1]);
+                js += "\"";
+                js += juce::Base64::toBase64(message.packedPayload.data() + headerSize,
+                                             message.packedPayload.size() - headerSize).toStdString();
+                js += "\"";
+            }
+            else
+            {
+                const auto event = choc::json::parse(getEncoded(message, SocketCodec::json));
+                const auto args = event["args"];
+                for (uint32_t i = 0; args.isArray() && i < args.size(); i++)
+                {
+                    if (i > 0) js += ",";
+                    js += choc::json::toString(args[i]);
+                }
+            }
+            js += ");";
+
+            auto evalMessage = choc::value::createObject("Message");
+            evalMessage.addMember("type", 3); // 3 = Evaluate
+            evalMessage.addMember("js", js);
+            return choc::json::toString(evalMessage);
+        }
+
+        static std::string_view getEventName(std::string_view functionName)
+        {
+            constexpr std::string_view prefix = "window.ui.";
+            if (functionName.starts_with(prefix)) functionName.remove_prefix(prefix.size());
+            return functionName;
+        }
 
         std::mutex activeClientsLock;
         std::vector<std::weak_ptr<ClientInstance>> activeClients{};
+        bool clientJoined {false};
+        std::vector<std::shared_ptr<ClientInstance>> clientsToSend;
     };
 }
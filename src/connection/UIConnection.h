@@ -3,8 +3,20 @@
 //
 
 #pragma once
+#include <atomic>
+#include <charconv>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 #include <choc/containers/choc_Value.h>
+#include <choc/text/choc_JSON.h>
 
 namespace imagiro {
     class UIConnection {
@@ -12,21 +24,280 @@ namespace imagiro {
         virtual ~UIConnection() = default;
         typedef std::function<choc::value::Value(const choc::value::ValueView &args)> CallbackFn;
 
-        void bind(const std::string &functionName, CallbackFn&& callback) {
-            auto callbackCopy = callback;
-            boundFunctions[functionName] = callbackCopy;
-            bindFunction(functionName, std::move(callback));
+        struct FrameListener {
+            virtual ~FrameListener() = default;
+            // Called on the message thread once per UI tick, before queued evals are sent
+            virtual void uiFrameStarting() = 0;
+            // Called on the message thread when a UI attaches after a period with none,
+            // or a page reloads or reconnects. Anything sent while detached was
+            // discarded, so listeners whose state is only ever pushed should resend it.
+            virtual void uiResyncRequested() {}
+            // Called on the message thread when the first UI attaches or the last one
+            // detaches, for listeners that only need to run while someone is watching
+            virtual void uiConsumersChanged(bool /*attached*/) {}
+        };
+
+        // Listeners are added, removed and called on the message thread only
+        void addFrameListener(FrameListener* l) {
+            std::erase(frameListeners, l);
+            frameListeners.push_back(l);
+        }
+
+        void removeFrameListener(FrameListener* l) {
+            std::erase(frameListeners, l);
+        }
+
+        typedef uint32_t FunctionID;
+
+        // Where a bound function may run when the transport lets us choose.
+        // Anything touching processor or UI state beyond atomic reads should stay
+        // on the message thread.
+        enum class CallThread {
+            message,    // dispatched to the message thread
+            any,        // thread-safe and cheap, run on whichever thread received the call
+            background  // thread-safe but slow, run on a worker thread
+        };
+
+        // Bound names are interned into small integer IDs. The callback is stored
+        // once, in the function table; backends only get a forwarder that calls
+        // through the table by ID.
+        // Socket clients look functions up from network threads while attachments
+        // may still be binding on the message thread, so the table is guarded. Calls
+        // take a reference to the callback under the lock and run outside it, so a
+        // rebind never pulls a function out from under a running call.
+        void bind(const std::string &functionName, CallbackFn&& callback,
+                  CallThread thread = CallThread::message) {
+            auto fn = std::make_shared<const CallbackFn>(std::move(callback));
+            FunctionID id;
+            {
+                std::unique_lock l(functionTableLock);
+                if (auto existing = functionIDs.find(functionName); existing != functionIDs.end()) {
+                    functionTable[existing->second] = std::move(fn);
+                    functionThreads[existing->second] = thread;
+                    return;
+                }
+
+                id = static_cast<FunctionID>(functionTable.size());
+                functionTable.push_back(std::move(fn));
+                functionThreads.push_back(thread);
+                functionNames.push_back(functionName);
+                functionIDs.insert({functionName, id});
+            }
+
+            bindFunction(functionName, [this, id](const choc::value::ValueView& args) {
+                return callFunction(id, args);
+            });
+        }
+
+        std::optional<FunctionID> getFunctionID(const std::string &functionName) const {
+            std::shared_lock l(functionTableLock);
+            auto it = functionIDs.find(functionName);
+            if (it == functionIDs.end()) return {};
+            return it->second;
+        }
+
+        bool hasFunction(FunctionID id) const {
+            std::shared_lock l(functionTableLock);
+            return id < functionTable.size();
+        }
+
+        CallThread getFunctionThread(FunctionID id) const {
+            std::shared_lock l(functionTableLock);
+            return id < functionThreads.size() ? functionThreads[id] : CallThread::message;
+        }
+
+        choc::value::Value callFunction(FunctionID id, const choc::value::ValueView& args) const {
+            auto fn = getCallback(id);
+            if (!fn) throw std::runtime_error("unable to find function " + std::to_string(id));
+            return (*fn)(args);
+        }
+
+        // Runs fn, wrapping its result in the { status, data } / { status, error }
+        // response shape the UI expects from bound calls
+        static choc::value::Value callWithResponse(const CallbackFn& fn, const choc::value::ValueView& args) {
+            auto responseState = choc::value::createObject("Response");
+            try {
+                auto response = fn(args);
+                responseState.setMember("status", "ok");
+                responseState.setMember("data", response);
+                return responseState;
+            } catch (const choc::value::Error& e) {
+                responseState.setMember("status", "error");
+                responseState.setMember("error", std::string(e.what()));
+                return responseState;
+            } catch (const std::exception& e) {
+                responseState.setMember("status", "error");
+                responseState.setMember("error", std::string(e.what()));
+                return responseState;
+            } catch (...) {
+                // anything else still gets a response, so one bad entry in a
+                // batch can't take the rest down with it
+                responseState.setMember("status", "error");
+                responseState.setMember("error", "unknown error");
+                return responseState;
+            }
+        }
+
+        // Runs a list of { fn, args } calls in one go, where fn is a bound name or
+        // ID. Returns one response per entry, so a failing call doesn't fail the batch.
+        choc::value::Value callBatch(const choc::value::ValueView& calls) const {
+            auto results = choc::value::createEmptyArray();
+            if (!calls.isArray()) return results;
+
+            for (uint32_t i = 0; i < calls.size(); i++) {
+                const auto call = calls[i];
+                const auto fn = call["fn"];
+
+                std::optional<FunctionID> id;
+                if (fn.isString()) id = getFunctionID(std::string(fn.getString()));
+                else if (fn.isInt()) id = static_cast<FunctionID>(fn.getWithDefault(-1));
+
+                results.addArrayElement(callWithResponse([&](const choc::value::ValueView& args) {
+                    auto callback = id ? getCallback(*id) : nullptr;
+                    if (!callback) {
+                        throw std::runtime_error("unable to find function " + choc::json::toString(fn));
+                    }
+                    return (*callback)(args);
+                }, call["args"]));
+            }
+
+            return results;
+        }
+
+        // { name: id } for every bound function, so the UI can make calls by ID
+        choc::value::Value getFunctionTable() const {
+            auto table = choc::value::createObject("FunctionTable");
+            std::shared_lock l(functionTableLock);
+            for (FunctionID id = 0; id < functionNames.size(); id++) {
+                table.addMember(functionNames[id], static_cast<int32_t>(id));
+            }
+            return table;
         }
 
         void eval(const std::string &functionName, const std::vector<choc::value::Value>& args = {}) {
+            if (!hasConsumers()) return;
             evalFunction(functionName, args);
         }
 
-        const std::unordered_map<std::string, CallbackFn>& getBoundFunctions() { return boundFunctions; }
+        // Calls functionName with a single binary payload. Each connection picks the
+        // cheapest encoding its transport allows.
+        void evalBinary(const std::string &functionName, const void* data, size_t size) {
+            if (!hasConsumers()) return;
+            evalBinaryFunction(functionName, data, size);
+        }
+
+        // False while no webview or socket client is attached. Evals are dropped
+        // in that state, so attachments can skip building them altogether.
+        bool hasConsumers() const { return consumersAttached.load(std::memory_order_relaxed); }
 
     protected:
-        virtual void bindFunction(const std::string &functionName, CallbackFn&& callback) = 0;
+        // Calls aimed at the same target (a parameter uid, a source id...) share a key,
+        // so a full eval queue can replace a stale call instead of dropping a fresh one
+        static void appendEvalKey(std::string& out, std::string_view functionName,
+                                  const std::vector<choc::value::Value>& args) {
+            out += functionName;
+            if (!args.empty() && (args[0].isString() || args[0].isInt())) {
+                out += ':';
+                appendJSON(out, args[0]);
+            }
+        }
+
+        // Appends v as JSON. Evals run every frame, so the common scalar types are
+        // written straight into `out` (a buffer the caller reuses) rather than
+        // through a temporary string. Floats and containers still go through choc.
+        static void appendJSON(std::string& out, const choc::value::ValueView& v) {
+            if (v.isString()) {
+                appendQuoted(out, v.getString());
+            } else if (v.isBool()) {
+                out += v.getBool() ? "true" : "false";
+            } else if (v.isInt32() || v.isInt64()) {
+                char digits[24];
+                auto end = std::to_chars(digits, digits + sizeof(digits), v.isInt32() ? v.getInt32() : v.getInt64()).ptr;
+                out.append(digits, end);
+            } else {
+                out += choc::json::toString(v);
+            }
+        }
+
+        static void appendQuoted(std::string& out, std::string_view s) {
+            static constexpr char hex[] = "0123456789abcdef";
+            out += '"';
+            for (auto c : s) {
+                switch (c) {
+                    case '"':  out += "\\\""; break;
+                    case '\\': out += "\\\\"; break;
+                    case '\n': out += "\\n"; break;
+                    case '\r': out += "\\r"; break;
+                    case '\t': out += "\\t"; break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20) {
+                            out += "\\u00";
+                            out += hex[(c >> 4) & 0xf];
+                            out += hex[c & 0xf];
+                        } else {
+                            out += c;
+                        }
+                }
+            }
+            out += '"';
+        }
+
+        // Bindings every connection provides, for calling by ID and in batches.
+        // Concrete connections call this from their constructor.
+        void bindBuiltins() {
+            bind("juce_getFunctionTable", [this](const choc::value::ValueView&) -> choc::value::Value {
+                return getFunctionTable();
+            });
+            bind("juce_callByID", [this](const choc::value::ValueView& args) -> choc::value::Value {
+                auto id = static_cast<FunctionID>(args[0].getWithDefault(-1));
+                return callFunction(id, args.size() > 1 ? args[1] : choc::value::ValueView());
+            });
+            bind("juce_batch", [this](const choc::value::ValueView& args) -> choc::value::Value {
+                return callBatch(args[0]);
+            });
+            // A page calls this once it has loaded. Reloads and reconnects don't change
+            // whether a UI is attached, so without it they'd only see later changes.
+            bind("juce_requestResync", [this](const choc::value::ValueView&) -> choc::value::Value {
+                requestResync();
+                return {};
+            });
+        }
+
+        void notifyFrameStarting() {
+            for (auto l : frameListeners) l->uiFrameStarting();
+        }
+
+        void requestResync() {
+            for (auto l : frameListeners) l->uiResyncRequested();
+        }
+
+        // Message thread only, since it may call the frame listeners
+        void setHasConsumers(bool hasConsumersNow) {
+            if (consumersAttached.exchange(hasConsumersNow) == hasConsumersNow) return;
+            for (auto l : frameListeners) l->uiConsumersChanged(hasConsumersNow);
+            if (hasConsumersNow) requestResync();
+        }
+
+        // Called once per newly bound name, with a forwarder into the function table.
+        // Only backends that have to register names with something else (the webview)
+        // need it; the socket connection dispatches straight through the table.
+        virtual void bindFunction(const std::string &/*functionName*/, CallbackFn&& /*callback*/) {}
         virtual void evalFunction(const std::string &functionName, const std::vector<choc::value::Value>& args = {}) = 0;
-        std::unordered_map<std::string, CallbackFn> boundFunctions;
+        virtual void evalBinaryFunction(const std::string &functionName, const void* data, size_t size) = 0;
+
+    private:
+        std::shared_ptr<const CallbackFn> getCallback(FunctionID id) const {
+            std::shared_lock l(functionTableLock);
+            return id < functionTable.size() ? functionTable[id] : nullptr;
+        }
+
+        mutable std::shared_mutex functionTableLock;
+        std::vector<std::shared_ptr<const CallbackFn>> functionTable;
+        std::vector<CallThread> functionThreads;
+        std::vector<std::string> functionNames;
+        std::unordered_map<std::string, FunctionID> functionIDs;
+
+        std::vector<FrameListener*> frameListeners;
+        std::atomic<bool> consumersAttached {false};
     };
 }
\ No newline at end of file
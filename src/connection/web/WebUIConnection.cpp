@@ -3,9 +3,9 @@
 
 namespace imagiro {
     WebUIConnection::WebUIConnection(AssetServer &server)
-        : server(server), jsEvalQueue(256)
+        : server(server)
     {
-        startTimerHz(60);
+        bindBuiltins();
     }
 
     void WebUIConnection::addListener(Listener* l) {
@@ -37,6 +37,7 @@ namespace imagiro {
             preparedWebview.reset();
         }
 
+        updateConsumers();
         return activeView;
     }
 
@@ -56,7 +57,7 @@ namespace imagiro {
                                 auto r = server.getResource(path);
                                 if (r) {
                                     r2 = choc::ui::WebView::Options::Resource();
-                                    r2->data = r->data;
+                                    r2->data.assign(r->data.begin(), r->data.end());
                                     r2->mimeType = r->mimeType;
                                 }
 
@@ -126,27 +127,64 @@ namespace imagiro {
         currentURL = "";
     }
 
-    void WebUIConnection::evaluateJavascript(const std::string& js) {
-        jsEvalQueue.enqueue(choc::json::toString(choc::value::Value(js)));
-    }
-
     void WebUIConnection::evalFunction(const std::string &functionName, const std::vector<choc::value::Value>& args) {
-        auto evalString = functionName + "(";
+        // built in per-thread buffers that keep their capacity, push() copies them into its slots
+        thread_local std::string key, argsString;
+        key.clear();
+        appendEvalKey(key, functionName, args);
+
+        argsString.assign("[");
         for (auto i=0u; i<args.size(); i++) {
-            evalString += choc::json::toString(args[i]);
-            if (i != args.size()-1) evalString += ",";
+            if (i > 0) argsString += ",";
+            appendJSON(argsString, args[i]);
         }
-        evalString += ");";
+        argsString += "]";
+
+        evalQueue.push(key, functionName, argsString);
+    }
+
+    void WebUIConnection::evalBinaryFunction(const std::string &functionName, const void* data, size_t size) {
+        // the webview bridge only carries text, so binary payloads go across as base64
+        auto base64 = juce::Base64::toBase64(data, size).toStdString();
+        evalQueue.push(functionName, functionName, "[\"" + base64 + "\"]");
+    }
 
-        evaluateJavascript(evalString);
+    void WebUIConnection::appendToBatch(std::string& batch, const EvalQueue::Message& call) {
+        batch += "[";
+        appendQuoted(batch, call.functionName);
+        batch += ",";
+        batch += call.payload;
+        batch += "]";
     }
 
     void WebUIConnection::timerCallback() {
-        std::string js;
-        while (jsEvalQueue.try_dequeue(js)) {
-            auto evalString = "if (window.ui && window.ui.evaluate) { window.ui.evaluate(" + js + "); }";
-            for (auto wv: activeWebViews) wv->evaluateJavascript(evalString);
+        // a full queue lost something, which may have been a one-shot event, so
+        // resend everything. Drops caused by the resync itself are ignored, or
+        // one too big for the queue would repeat every tick.
+        const bool dropped = evalQueue.takeDropped();
+        if (dropped) requestResync();
+        notifyFrameStarting();
+        if (dropped) evalQueue.takeDropped();
+
+        // All calls queued since the last tick go out as a single eval per webview.
+        // Older UIs without evaluateBatch get each call passed to evaluate() as before.
+        // The calls are taken off the queue first, so the script is built outside its lock.
+        auto numCalls = evalQueue.popBatch(pendingCalls, maxBytesPerFrame);
+        if (numCalls == 0) return;
+
+        batch.assign("(function(calls) {"
+                     " if (!window.ui) return;"
+                     " if (window.ui.evaluateBatch) { window.ui.evaluateBatch(calls); return; }"
+                     " if (!window.ui.evaluate) return;"
+                     " for (const c of calls) window.ui.evaluate(c[0] + \"(\" + c[1].map(a => JSON.stringify(a)).join(\",\") + \");\");"
+                     " })([");
+        for (size_t i = 0; i < numCalls; i++) {
+            if (i > 0) batch += ",";
+            appendToBatch(batch, pendingCalls[i]);
         }
+        batch += "]);";
+
+        for (auto wv: activeWebViews) wv->evaluateJavascript(batch);
     }
 
     void WebUIConnection::bindFunction(const std::string &functionName, CallbackFn &&fn) {
@@ -160,17 +198,7 @@ namespace imagiro {
 
     choc::ui::WebView::CallbackFn WebUIConnection::wrapFn(choc::ui::WebView::CallbackFn func) {
         return [func](const choc::value::ValueView& args) -> choc::value::Value {
-            auto responseState = choc::value::createObject("Response");
-            try {
-                auto response = func(args);
-                responseState.setMember("status", "ok");
-                responseState.setMember("data", response);
-                return responseState;
-            } catch (std::exception& e) {
-                responseState.setMember("status", "error");
-                responseState.setMember("error", e.what());
-                return responseState;
-            }
+            return callWithResponse(func, args);
         };
     }
 
@@ -180,10 +208,31 @@ namespace imagiro {
 
     void WebUIConnection::removeWebView(choc::ui::WebView* v) {
         activeWebViews.removeFirstMatchingValue(v);
+        updateConsumers();
     }
 
     bool WebUIConnection::isShowing() {
-        return !activeWebViews.isEmpty();
+        return hasConsumers();
+    }
+
+    void WebUIConnection::updateConsumers() {
+        // the prepared webview isn't attached to an editor yet, so it doesn't count
+        auto numConsumers = activeWebViews.size();
+        if (preparedWebview && activeWebViews.contains(preparedWebview.get())) numConsumers--;
+
+        if ((numConsumers > 0) == hasConsumers()) return;
+
+        // whatever was queued before the last editor closed is stale by now, the
+        // resync that follows sends current state instead
+        evalQueue.clear();
+
+        if (numConsumers > 0) {
+            setHasConsumers(true);
+            startTimerHz(60);
+        } else {
+            stopTimer();
+            setHasConsumers(false);
+        }
     }
 
     void WebUIConnection::setupWebview(choc::ui::WebView& wv) {
@@ -4,6 +4,7 @@
 #include <juce_core/juce_core.h>
 #include "imagiro_webview/src/AssetServer/BinaryDataAssetServer.h"
 #include "../UIConnection.h"
+#include "../EvalQueue.h"
 #include <imagiro_processor/config/Resources.h>
 
 namespace imagiro {
@@ -27,8 +28,15 @@ namespace imagiro {
         static void bindEditorSpecificFunctions(choc::ui::WebView& view, WebUIPluginEditor* editor);
 
         void evalFunction(const std::string &functionName, const std::vector<choc::value::Value> &args = {}) override;
+        void evalBinaryFunction(const std::string &functionName, const void* data, size_t size) override;
         void bindFunction(const std::string &functionName, CallbackFn&& callback) override;
 
+        // Upper bound on the size of the batch sent to each webview per timer tick.
+        // Calls that don't fit are held back until the next tick.
+        void setMaxBytesPerFrame(size_t bytes) { maxBytesPerFrame = bytes; }
+
+        EvalQueue& getEvalQueue() { return evalQueue; }
+
         void requestFileChooser(juce::String patternsAllowed = "*.wav", bool isNewFile = false, juce::File openTo = juce::File());
 
         void navigate(const std::string &url);
@@ -43,7 +51,8 @@ namespace imagiro {
 
     private:
         static choc::ui::WebView::CallbackFn wrapFn(choc::ui::WebView::CallbackFn func);
-        void evaluateJavascript(const std::string& js);
+        static void appendToBatch(std::string& batch, const EvalQueue::Message& call);
+        void updateConsumers();
 
         juce::ListenerList<Listener> listeners;
         std::shared_ptr<choc::ui::WebView> preparedWebview;
@@ -52,7 +61,10 @@ namespace imagiro {
         std::optional<std::string> htmlToSet;
         std::optional<std::string> currentURL;
         AssetServer& server;
-        moodycamel::ConcurrentQueue<std::string> jsEvalQueue;
+        EvalQueue evalQueue {256, EvalQueue::OverflowPolicy::coalesceByKey};
+        std::vector<EvalQueue::Message> pendingCalls;
+        std::string batch;
+        size_t maxBytesPerFrame {256 * 1024};
 
         juce::SharedResourcePointer<Resources> resources;
     };
@@ -0,0 +1,144 @@
+#include <catch2/catch_test_macros.hpp>
+#include "../src/AssetServer/AssetServer.h"
+
+TEST_CASE("Accept-Encoding negotiation", "[assets][encoding]") {
+    SECTION("Accepts listed encodings") {
+        REQUIRE(AssetServer::acceptsEncoding("gzip, deflate, br", "br"));
+        REQUIRE(AssetServer::acceptsEncoding("gzip, deflate, br", "gzip"));
+        REQUIRE_FALSE(AssetServer::acceptsEncoding("gzip, deflate", "br"));
+        REQUIRE_FALSE(AssetServer::acceptsEncoding("", "gzip"));
+    }
+
+    SECTION("Ignores case and whitespace") {
+        REQUIRE(AssetServer::acceptsEncoding("GZip ;q=0.5", "gzip"));
+        REQUIRE(AssetServer::acceptsEncoding(" deflate,\tbr ", "br"));
+    }
+
+    SECTION("q=0 refuses an encoding") {
+        REQUIRE_FALSE(AssetServer::acceptsEncoding("gzip;q=0", "gzip"));
+        REQUIRE_FALSE(AssetServer::acceptsEncoding("gzip; q=0.000", "gzip"));
+        REQUIRE(AssetServer::acceptsEncoding("gzip;q=0.1", "gzip"));
+        REQUIRE(AssetServer::acceptsEncoding("gzip;q=1", "gzip"));
+    }
+
+    SECTION("Wildcard covers unlisted encodings only") {
+        REQUIRE(AssetServer::acceptsEncoding("*", "br"));
+        REQUIRE_FALSE(AssetServer::acceptsEncoding("*;q=0", "br"));
+        REQUIRE_FALSE(AssetServer::acceptsEncoding("gzip;q=0, *", "gzip"));
+        REQUIRE_FALSE(AssetServer::acceptsEncoding("*, gzip;q=0", "gzip"));
+        REQUIRE(AssetServer::acceptsEncoding("gzip;q=0, *", "br"));
+        REQUIRE(AssetServer::acceptsEncoding("br, *;q=0", "br"));
+    }
+}
+
+TEST_CASE("Entity tag validation", "[assets][etag]") {
+    SECTION("Content hashes are stable, quoted and content-dependent") {
+        const uint8_t a[] = {1, 2, 3};
+        const uint8_t b[] = {1, 2, 4};
+        auto etag = AssetServer::makeETag(a);
+        REQUIRE(etag.size() == 18);
+        REQUIRE(etag.front() == '"');
+        REQUIRE(etag.back() == '"');
+        REQUIRE(etag == AssetServer::makeETag(a));
+        REQUIRE(etag != AssetServer::makeETag(b));
+    }
+
+    SECTION("Matches strong and weak tags either way round") {
+        REQUIRE(AssetServer::etagMatches("\"abc\"", "\"abc\""));
+        REQUIRE(AssetServer::etagMatches("W/\"abc\"", "\"abc\""));
+        REQUIRE(AssetServer::etagMatches("\"abc\"", "W/\"abc\""));
+        REQUIRE_FALSE(AssetServer::etagMatches("\"abd\"", "\"abc\""));
+        REQUIRE_FALSE(AssetServer::etagMatches("abc", "\"abc\""));
+    }
+
+    SECTION("Matches any entry in a list, and *") {
+        REQUIRE(AssetServer::etagMatches("\"x\", W/\"abc\" ,\"y\"", "\"abc\""));
+        REQUIRE_FALSE(AssetServer::etagMatches("\"x\", \"y\"", "\"abc\""));
+        REQUIRE(AssetServer::etagMatches("*", "\"abc\""));
+    }
+
+    SECTION("Never matches without a tag or a header") {
+        REQUIRE_FALSE(AssetServer::etagMatches("", "\"abc\""));
+        REQUIRE_FALSE(AssetServer::etagMatches("*", ""));
+    }
+}
+
+TEST_CASE("Hashed filename detection", "[assets][etag]") {
+    REQUIRE(AssetServer::isHashedFilename("/assets/index-BxYz12Ab.js"));
+    REQUIRE(AssetServer::isHashedFilename("app.3f9a1c2b.css"));
+    REQUIRE(AssetServer::isHashedFilename("/chunk-a1_b2c3d4.mjs"));
+
+    // too short, no digit, or not a hash-like segment
+    REQUIRE_FALSE(AssetServer::isHashedFilename("/assets/index-1a2b.js"));
+    REQUIRE_FALSE(AssetServer::isHashedFilename("/assets/my-component.js"));
+    REQUIRE_FALSE(AssetServer::isHashedFilename("/index.html"));
+    REQUIRE_FALSE(AssetServer::isHashedFilename("/fonts/Inter-Regular.woff2"));
+    REQUIRE_FALSE(AssetServer::isHashedFilename("/assets/index-BxYz12Ab"));
+}
+
+namespace {
+    // A 10 byte body with a Range header applied
+    AssetServer::Resource withRange(std::string_view rangeHeader) {
+        static const uint8_t body[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+        AssetServer::Resource r;
+        r.data = body;
+        AssetServer::applyRange(r, rangeHeader);
+        return r;
+    }
+}
+
+TEST_CASE("Byte range requests", "[assets][range]") {
+    SECTION("Closed range") {
+        auto r = withRange("bytes=2-4");
+        REQUIRE(r.partial);
+        REQUIRE(r.data.size() == 3);
+        REQUIRE(r.data[0] == 2);
+        REQUIRE(r.getContentRange() == "bytes 2-4/10");
+    }
+
+    SECTION("Open-ended range runs to the end") {
+        auto r = withRange("bytes=7-");
+        REQUIRE(r.partial);
+        REQUIRE(r.getContentRange() == "bytes 7-9/10");
+    }
+
+    SECTION("Suffix range takes the last N bytes") {
+        auto r = withRange("bytes=-3");
+        REQUIRE(r.partial);
+        REQUIRE(r.getContentRange() == "bytes 7-9/10");
+
+        auto whole = withRange("bytes=-50");
+        REQUIRE(whole.partial);
+        REQUIRE(whole.getContentRange() == "bytes 0-9/10");
+    }
+
+    SECTION("Over-long ranges are clamped, not wrapped") {
+        auto r = withRange("bytes=5-99999999999999999999999999");
+        REQUIRE(r.partial);
+        REQUIRE(r.getContentRange() == "bytes 5-9/10");
+
+        auto suffix = withRange("bytes=-99999999999999999999999999");
+        REQUIRE(suffix.getContentRange() == "bytes 0-9/10");
+
+        auto start = withRange("bytes=99999999999999999999999999-");
+        REQUIRE(start.rangeNotSatisfiable);
+    }
+
+    SECTION("Valid ranges past the end are unsatisfiable") {
+        auto r = withRange("bytes=10-12");
+        REQUIRE(r.rangeNotSatisfiable);
+        REQUIRE(r.data.empty());
+        REQUIRE(r.getContentRange() == "bytes */10");
+
+        REQUIRE(withRange("bytes=-0").rangeNotSatisfiable);
+    }
+
+    SECTION("Invalid ranges are ignored and serve the full body") {
+        for (auto header : {"bytes=5-3", "bytes=-", "bytes=a-b", "bytes=1-2,4-5", "items=0-1", "bytes=3"}) {
+            auto r = withRange(header);
+            REQUIRE_FALSE(r.partial);
+            REQUIRE_FALSE(r.rangeNotSatisfiable);
+            REQUIRE(r.data.size() == 10);
+        }
+    }
+}
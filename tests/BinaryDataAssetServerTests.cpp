@@ -0,0 +1,110 @@
+#include <catch2/catch_test_macros.hpp>
+#include <juce_core/juce_core.h>
+#include "../src/AssetServer/BinaryDataAssetServer.h"
+
+using namespace imagiro;
+
+namespace {
+    BinaryDataAssetServer makeServer() {
+        return BinaryDataAssetServer(
+            [](const char*, int& size) -> const char* { size = 0; return nullptr; },
+            [](const char*) -> const char* { return ""; });
+    }
+
+    std::string contents(const AssetServer::Resource& r) {
+        return {reinterpret_cast<const char*>(r.data.data()), r.data.size()};
+    }
+}
+
+TEST_CASE("Files from disk are cached and revalidated", "[assets][files]") {
+    auto tempDir = juce::File::getSpecialLocation(juce::File::tempDirectory)
+        .getChildFile("asset_file_cache_test_" + juce::Uuid().toString());
+    tempDir.createDirectory();
+    auto server = makeServer();
+
+    SECTION("Repeat requests share the cached contents") {
+        auto file = tempDir.getChildFile("style.css");
+        file.replaceWithText("body {}");
+
+        auto first = server.getFileResource("/$RES/style.css", file);
+        auto second = server.getFileResource("/$RES/style.css", file);
+        REQUIRE(first);
+        REQUIRE(second);
+        REQUIRE(contents(*first) == "body {}");
+        REQUIRE(first->mimeType == "text/css");
+        REQUIRE(first->owner == second->owner);
+        REQUIRE(first->etag == second->etag);
+    }
+
+    SECTION("A changed file is read again") {
+        auto file = tempDir.getChildFile("data.json");
+        file.replaceWithText("[1]");
+        auto before = server.getFileResource("/$RES/data.json", file);
+
+        file.replaceWithText("[1,2]");
+        auto afterResize = server.getFileResource("/$RES/data.json", file);
+        REQUIRE(contents(*afterResize) == "[1,2]");
+        REQUIRE(afterResize->etag != before->etag);
+        // the old contents stay valid for whoever still holds them
+        REQUIRE(contents(*before) == "[1]");
+
+        // same size, newer mtime
+        file.replaceWithText("[3,4]");
+        file.setLastModificationTime(juce::Time::getCurrentTime() + juce::RelativeTime::seconds(10));
+        auto afterTouch = server.getFileResource("/$RES/data.json", file);
+        REQUIRE(contents(*afterTouch) == "[3,4]");
+        REQUIRE(afterTouch->owner != afterResize->owner);
+    }
+
+    SECTION("Missing files aren't served") {
+        REQUIRE_FALSE(server.getFileResource("/$RES/missing.js", tempDir.getChildFile("missing.js")));
+    }
+
+    SECTION("Least recently used files are evicted past the budget") {
+        server.setFileCacheBudget(20);
+        auto a = tempDir.getChildFile("a.txt");
+        auto b = tempDir.getChildFile("b.txt");
+        auto c = tempDir.getChildFile("c.txt");
+        a.replaceWithText("aaaaaaaaa");
+        b.replaceWithText("bbbbbbbbb");
+        c.replaceWithText("ccccccccc");
+
+        auto firstA = server.getFileResource("/$RES/a.txt", a);
+        auto firstB = server.getFileResource("/$RES/b.txt", b);
+        // touching a leaves b as the oldest
+        REQUIRE(server.getFileResource("/$RES/a.txt", a)->owner == firstA->owner);
+        server.getFileResource("/$RES/c.txt", c);
+
+        REQUIRE(server.getFileResource("/$RES/a.txt", a)->owner == firstA->owner);
+        auto secondB = server.getFileResource("/$RES/b.txt", b);
+        REQUIRE(secondB->owner != firstB->owner);
+        REQUIRE(contents(*secondB) == "bbbbbbbbb");
+        REQUIRE(contents(*firstB) == "bbbbbbbbb");
+    }
+
+    SECTION("Files over the budget are served but not cached") {
+        server.setFileCacheBudget(4);
+        auto file = tempDir.getChildFile("big.txt");
+        file.replaceWithText("too big to cache");
+
+        auto first = server.getFileResource("/$RES/big.txt", file);
+        auto second = server.getFileResource("/$RES/big.txt", file);
+        REQUIRE(contents(*first) == "too big to cache");
+        REQUIRE(first->owner != second->owner);
+    }
+
+    SECTION("Big files are mapped per request rather than cached") {
+        server.setFileMapThreshold(16);
+        auto file = tempDir.getChildFile("video.webm");
+        file.replaceWithText(std::string(64, 'v'));
+
+        auto first = server.getFileResource("/$RES/video.webm", file);
+        auto second = server.getFileResource("/$RES/video.webm", file);
+        REQUIRE(first->data.size() == 64);
+        REQUIRE(first->data[63] == 'v');
+        REQUIRE(first->mimeType == "video/webm");
+        REQUIRE(first->owner != second->owner);
+    }
+
+    tempDir.deleteRecursively();
+}
@@ -0,0 +1,161 @@
+#include <catch2/catch_test_macros.hpp>
+#include "../src/connection/EvalQueue.h"
+
+using imagiro::EvalQueue;
+
+namespace {
+    std::vector<std::string> drain(EvalQueue& queue) {
+        std::vector<std::string> payloads;
+        EvalQueue::Message message;
+        while (queue.pop(message)) payloads.push_back(message.payload);
+        return payloads;
+    }
+}
+
+TEST_CASE("EvalQueue ordering", "[evalqueue]") {
+    SECTION("Pops in push order") {
+        EvalQueue queue(4);
+        queue.push("a", "fn", "1");
+        queue.push("b", "fn", "2", "packed");
+
+        EvalQueue::Message message;
+        REQUIRE(queue.pop(message));
+        REQUIRE(message.key == "a");
+        REQUIRE(message.functionName == "fn");
+        REQUIRE(message.payload == "1");
+        REQUIRE(message.packedPayload.empty());
+        REQUIRE(queue.pop(message));
+        REQUIRE(message.payload == "2");
+        REQUIRE(message.packedPayload == "packed");
+        REQUIRE_FALSE(queue.pop(message));
+    }
+
+    SECTION("Keeps order across wraparound") {
+        EvalQueue queue(3);
+        EvalQueue::Message message;
+        for (int round = 0; round < 5; round++) {
+            queue.push("a", "fn", std::to_string(round * 2));
+            queue.push("b", "fn", std::to_string(round * 2 + 1));
+            REQUIRE(queue.pop(message));
+            REQUIRE(message.payload == std::to_string(round * 2));
+            REQUIRE(queue.pop(message));
+            REQUIRE(message.payload == std::to_string(round * 2 + 1));
+        }
+        REQUIRE_FALSE(queue.takeDropped());
+    }
+}
+
+TEST_CASE("EvalQueue overflow policies", "[evalqueue][overflow]") {
+    SECTION("dropOldest overwrites the oldest message") {
+        EvalQueue queue(3, EvalQueue::OverflowPolicy::dropOldest);
+        for (int i = 0; i < 5; i++) queue.push(std::to_string(i), "fn", std::to_string(i));
+        const std::vector<std::string> expected {"2", "3", "4"};
+        REQUIRE(drain(queue) == expected);
+    }
+
+    SECTION("dropNewest discards incoming messages") {
+        EvalQueue queue(3, EvalQueue::OverflowPolicy::dropNewest);
+        for (int i = 0; i < 5; i++) queue.push(std::to_string(i), "fn", std::to_string(i));
+        const std::vector<std::string> expected {"0", "1", "2"};
+        REQUIRE(drain(queue) == expected);
+    }
+
+    SECTION("coalesceByKey replaces the queued message with the same key") {
+        EvalQueue queue(3, EvalQueue::OverflowPolicy::coalesceByKey);
+        queue.push("a", "fn", "a1");
+        queue.push("b", "fn", "b1");
+        queue.push("c", "fn", "c1");
+        queue.push("b", "fn", "b2");
+        const std::vector<std::string> expected {"a1", "b2", "c1"};
+        REQUIRE(drain(queue) == expected);
+    }
+
+    SECTION("coalesceByKey drops the oldest when no key matches") {
+        EvalQueue queue(3, EvalQueue::OverflowPolicy::coalesceByKey);
+        queue.push("a", "fn", "a1");
+        queue.push("b", "fn", "b1");
+        queue.push("c", "fn", "c1");
+        queue.push("d", "fn", "d1");
+        queue.push("", "fn", "none");
+        const std::vector<std::string> expected {"c1", "d1", "none"};
+        REQUIRE(drain(queue) == expected);
+    }
+
+    SECTION("Every overflow is reported once through takeDropped") {
+        for (auto policy : {EvalQueue::OverflowPolicy::dropOldest,
+                            EvalQueue::OverflowPolicy::dropNewest,
+                            EvalQueue::OverflowPolicy::coalesceByKey}) {
+            EvalQueue queue(2, policy);
+            queue.push("a", "fn", "1");
+            queue.push("b", "fn", "2");
+            REQUIRE_FALSE(queue.takeDropped());
+            queue.push("a", "fn", "3");
+            REQUIRE(queue.takeDropped());
+            REQUIRE_FALSE(queue.takeDropped());
+        }
+    }
+
+    SECTION("clear() forgets drops") {
+        EvalQueue queue(1);
+        queue.push("a", "fn", "1");
+        queue.push("b", "fn", "2");
+        queue.clear();
+        REQUIRE_FALSE(queue.takeDropped());
+        REQUIRE(drain(queue).empty());
+    }
+}
+
+TEST_CASE("EvalQueue batches", "[evalqueue][batch]") {
+    EvalQueue queue(8);
+    std::vector<EvalQueue::Message> batch;
+
+    SECTION("Stops before the byte budget is exceeded") {
+        // each message is 2 bytes of name plus 4 of payload
+        for (int i = 0; i < 5; i++) queue.push("", "fn", "abc" + std::to_string(i));
+        REQUIRE(queue.popBatch(batch, 13) == 2);
+        REQUIRE(batch[0].payload == "abc0");
+        REQUIRE(batch[1].payload == "abc1");
+        REQUIRE(queue.popBatch(batch, 18) == 3);
+        REQUIRE(batch[2].payload == "abc4");
+        REQUIRE(queue.popBatch(batch, 100) == 0);
+    }
+
+    SECTION("Always takes at least one message") {
+        queue.push("", "fn", std::string(64, 'x'));
+        queue.push("", "fn", "small");
+        REQUIRE(queue.popBatch(batch, 1) == 1);
+        REQUIRE(batch[0].payload.size() == 64);
+        REQUIRE(queue.popBatch(batch, 1) == 1);
+        REQUIRE(batch[0].payload == "small");
+    }
+
+    SECTION("Reuses the spare entries of the output") {
+        for (int i = 0; i < 4; i++) queue.push("", "fn", "p");
+        REQUIRE(queue.popBatch(batch, 100) == 4);
+        REQUIRE(batch.size() == 4);
+        queue.push("", "fn", "q");
+        REQUIRE(queue.popBatch(batch, 100) == 1);
+        REQUIRE(batch.size() == 4);
+        REQUIRE(batch[0].payload == "q");
+    }
+}
+
+TEST_CASE("EvalQueue stats", "[evalqueue][stats]") {
+    EvalQueue queue(2);
+    queue.push("a", "fn", "1");
+    queue.push("b", "fn", "2");
+    queue.push("c", "fn", "3");
+
+    auto stats = queue.getStats();
+    REQUIRE(stats.enqueued == 3);
+    REQUIRE(stats.dropped == 1);
+    REQUIRE(stats.depth == 2);
+    REQUIRE(stats.peakDepth == 2);
+
+    EvalQueue::Message message;
+    queue.pop(message);
+    stats = queue.getStats();
+    REQUIRE(stats.depth == 1);
+    REQUIRE(stats.peakDepth == 2);
+    REQUIRE(stats.enqueued == 3);
+}
@@ -0,0 +1,205 @@
+#include <catch2/catch_test_macros.hpp>
+#include <limits>
+#include "../src/connection/MessagePack.h"
+
+using namespace imagiro;
+
+namespace {
+    std::string bytes(std::initializer_list<int> values) {
+        std::string out;
+        for (auto v : values) out += static_cast<char>(v);
+        return out;
+    }
+
+    int64_t roundTripInt(int64_t i) {
+        auto decoded = msgpack::decode(msgpack::encode(choc::value::Value(i)));
+        REQUIRE((decoded.isInt32() || decoded.isInt64()));
+        return decoded.isInt32() ? decoded.getInt32() : decoded.getInt64();
+    }
+}
+
+TEST_CASE("MessagePack integers", "[msgpack][int]") {
+    SECTION("Round trip at every width boundary") {
+        constexpr auto int32Min = static_cast<int64_t>(std::numeric_limits<int32_t>::min());
+        constexpr auto int32Max = static_cast<int64_t>(std::numeric_limits<int32_t>::max());
+        for (int64_t i : {int64_t(0), int64_t(127), int64_t(128), int64_t(255), int64_t(256),
+                          int64_t(65535), int64_t(65536), int64_t(-1), int64_t(-32), int64_t(-33),
+                          int64_t(-128), int64_t(-129), int64_t(-32768), int64_t(-32769),
+                          int32Min, int32Max, int32Min - 1, int32Max + 1,
+                          std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max()}) {
+            REQUIRE(roundTripInt(i) == i);
+        }
+    }
+
+    SECTION("Uses the smallest encoding it writes") {
+        REQUIRE(msgpack::encode(choc::value::Value(int64_t(127))).size() == 1);
+        REQUIRE(msgpack::encode(choc::value::Value(int64_t(128))).size() == 5);
+        REQUIRE(msgpack::encode(choc::value::Value(int64_t(-32))).size() == 1);
+        REQUIRE(msgpack::encode(choc::value::Value(int64_t(-33))).size() == 5);
+        REQUIRE(msgpack::encode(choc::value::Value(int64_t(1) << 31)).size() == 9);
+    }
+
+    SECTION("Decodes the widths other encoders write") {
+        REQUIRE(msgpack::decode(bytes({0xcc, 0xff})).getInt32() == 255);
+        REQUIRE(msgpack::decode(bytes({0xcd, 0xff, 0xff})).getInt32() == 65535);
+        REQUIRE(msgpack::decode(bytes({0xce, 0xff, 0xff, 0xff, 0xff})).getInt64() == 4294967295);
+        REQUIRE(msgpack::decode(bytes({0xcf, 0, 0, 0, 1, 0, 0, 0, 0})).getInt64() == 4294967296);
+        REQUIRE(msgpack::decode(bytes({0xd0, 0x80})).getInt32() == -128);
+        REQUIRE(msgpack::decode(bytes({0xd1, 0x80, 0x00})).getInt32() == -32768);
+    }
+
+    SECTION("Rejects uint64 values an int64 can't hold") {
+        REQUIRE_THROWS(msgpack::decode(bytes({0xcf, 0x80, 0, 0, 0, 0, 0, 0, 0})));
+    }
+}
+
+TEST_CASE("MessagePack floats", "[msgpack][float]") {
+    auto f = msgpack::decode(msgpack::encode(choc::value::Value(1.5f)));
+    REQUIRE(f.isFloat32());
+    REQUIRE(f.getFloat32() == 1.5f);
+
+    auto d = msgpack::decode(msgpack::encode(choc::value::Value(0.1)));
+    REQUIRE(d.isFloat64());
+    REQUIRE(d.getFloat64() == 0.1);
+
+    REQUIRE(msgpack::encode(choc::value::Value(1.5f)).size() == 5);
+    REQUIRE(msgpack::encode(choc::value::Value(0.1)).size() == 9);
+}
+
+TEST_CASE("MessagePack strings", "[msgpack][string]") {
+    const std::pair<size_t, int> cases[] = {{0, 0xa0}, {31, 0xbf}, {32, 0xd9}, {255, 0xd9},
+                                            {256, 0xda}, {65535, 0xda}, {65536, 0xdb}};
+    for (auto [size, header] : cases) {
+        const std::string s(size, 'x');
+        const auto encoded = msgpack::encode(choc::value::Value(s));
+        REQUIRE(static_cast<uint8_t>(encoded[0]) == header);
+
+        const auto decoded = msgpack::decode(encoded);
+        REQUIRE(decoded.isString());
+        REQUIRE(decoded.getString() == s);
+    }
+}
+
+TEST_CASE("MessagePack arrays and maps", "[msgpack][container]") {
+    SECTION("Arrays switch to array16 past 15 elements") {
+        const std::pair<uint32_t, int> cases[] = {{0, 0x90}, {15, 0x9f}, {16, 0xdc}};
+        for (auto [size, header] : cases) {
+            auto array = choc::value::createEmptyArray();
+            for (uint32_t i = 0; i < size; i++) array.addArrayElement(static_cast<int32_t>(i));
+
+            const auto encoded = msgpack::encode(array);
+            REQUIRE(static_cast<uint8_t>(encoded[0]) == header);
+
+            const auto decoded = msgpack::decode(encoded);
+            REQUIRE(decoded.isArray());
+            REQUIRE(decoded.size() == size);
+            if (size > 0) REQUIRE(decoded[size - 1].getInt32() == static_cast<int32_t>(size - 1));
+        }
+    }
+
+    SECTION("Maps switch to map16 past 15 members") {
+        const std::pair<uint32_t, int> cases[] = {{1, 0x81}, {15, 0x8f}, {16, 0xde}};
+        for (auto [size, header] : cases) {
+            auto object = choc::value::createObject("");
+            for (uint32_t i = 0; i < size; i++) object.addMember("m" + std::to_string(i), static_cast<int32_t>(i));
+
+            const auto encoded = msgpack::encode(object);
+            REQUIRE(static_cast<uint8_t>(encoded[0]) == header);
+
+            const auto decoded = msgpack::decode(encoded);
+            REQUIRE(decoded.isObject());
+            REQUIRE(decoded.size() == size);
+            REQUIRE(decoded["m0"].getInt32() == 0);
+        }
+    }
+
+    SECTION("32-bit headers") {
+        std::string header;
+        msgpack::appendArrayHeader(header, 65536);
+        REQUIRE(header == bytes({0xdd, 0, 1, 0, 0}));
+        header.clear();
+        msgpack::appendMapHeader(header, 65536);
+        REQUIRE(header == bytes({0xdf, 0, 1, 0, 0}));
+
+        auto array = msgpack::decode(bytes({0xdd, 0, 0, 0, 2, 0x01, 0x02}));
+        REQUIRE(array.size() == 2);
+        REQUIRE(array[1].getInt32() == 2);
+
+        auto map = msgpack::decode(bytes({0xdf, 0, 0, 0, 1, 0xa1, 'k', 0xc3}));
+        REQUIRE(map["k"].getBool());
+    }
+
+    SECTION("Nested messages round trip") {
+        auto message = choc::value::createObject("Message");
+        message.addMember("type", 5);
+        message.addMember("event", "updateParameterState");
+        auto args = choc::value::createEmptyArray();
+        args.addArrayElement("cutoff");
+        args.addArrayElement(0.25f);
+        args.addArrayElement(choc::value::Value());
+        message.addMember("args", args);
+
+        const auto decoded = msgpack::decode(msgpack::encode(message));
+        REQUIRE(decoded["type"].getInt32() == 5);
+        REQUIRE(decoded["event"].getString() == "updateParameterState");
+        REQUIRE(decoded["args"].size() == 3);
+        REQUIRE(decoded["args"][1].getFloat32() == 0.25f);
+        REQUIRE(decoded["args"][2].isVoid());
+    }
+}
+
+TEST_CASE("MessagePack bin and ext", "[msgpack][bin]") {
+    SECTION("bin decodes as a string of its bytes") {
+        auto bin8 = msgpack::decode(bytes({0xc4, 3, 0x00, 0xff, 0x7f}));
+        REQUIRE(bin8.isString());
+        REQUIRE(bin8.getString() == bytes({0x00, 0xff, 0x7f}));
+
+        REQUIRE(msgpack::decode(bytes({0xc5, 0, 1, 'a'})).getString() == "a");
+        REQUIRE(msgpack::decode(bytes({0xc6, 0, 0, 0, 2, 'a', 'b'})).getString() == "ab");
+    }
+
+    SECTION("ext and the unused type byte are rejected") {
+        for (auto type : {0xc7, 0xc8, 0xc9, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xc1}) {
+            REQUIRE_THROWS(msgpack::decode(bytes({type, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0})));
+        }
+    }
+}
+
+TEST_CASE("MessagePack rejects malformed input", "[msgpack][malformed]") {
+    SECTION("Every truncation of a message throws") {
+        auto message = choc::value::createObject("Message");
+        message.addMember("id", "abc");
+        message.addMember("value", 1.5);
+        message.addMember("big", int64_t(1) << 40);
+        message.addMember("text", std::string(40, 't'));
+        const auto encoded = msgpack::encode(message);
+
+        for (size_t size = 0; size < encoded.size(); size++) {
+            REQUIRE_THROWS(msgpack::decode(std::string_view(encoded).substr(0, size)));
+        }
+    }
+
+    SECTION("Lengths past the end of the data throw") {
+        REQUIRE_THROWS(msgpack::decode(bytes({0xdb, 0xff, 0xff, 0xff, 0xff, 'a'})));
+        REQUIRE_THROWS(msgpack::decode(bytes({0xdd, 0xff, 0xff, 0xff, 0xff})));
+    }
+
+    SECTION("Only string map keys are accepted") {
+        REQUIRE_THROWS(msgpack::decode(bytes({0x81, 0x01, 0x02})));
+    }
+
+    SECTION("Nesting is capped") {
+        std::string nested(msgpack::detail::Reader::maxDepth - 1, static_cast<char>(0x91));
+        nested += static_cast<char>(0x90);
+        REQUIRE_NOTHROW(msgpack::decode(nested));
+
+        std::string tooDeep(msgpack::detail::Reader::maxDepth, static_cast<char>(0x91));
+        tooDeep += static_cast<char>(0x90);
+        REQUIRE_THROWS(msgpack::decode(tooDeep));
+
+        std::string deepMaps;
+        for (int i = 0; i < msgpack::detail::Reader::maxDepth + 1; i++) deepMaps += bytes({0x81, 0xa1, 'k'});
+        deepMaps += static_cast<char>(0xc0);
+        REQUIRE_THROWS(msgpack::decode(deepMaps));
+    }
+}
@@ -0,0 +1,118 @@
+#include <catch2/catch_test_macros.hpp>
+#include "../src/attachment/util/ParameterUpdateBatch.h"
+
+using imagiro::ParameterUpdateBatch;
+
+namespace {
+    // Stands in for the processor's parameters and for one UI frame of
+    // ParameterAttachment: changed slots become single updates, or one snapshot
+    struct FakeParameters {
+        explicit FakeParameters(size_t n) : values(n, 0.f) { batch.resize(n); }
+
+        void set(size_t slot, float value01) {
+            values[slot] = value01;
+            batch.markDirty(slot);
+        }
+
+        void frame() {
+            const auto& changed = batch.collect([this](size_t slot) { return values[slot]; });
+            if (batch.shouldSendSnapshot()) {
+                snapshots++;
+                batch.markAllSent(values);
+                return;
+            }
+            for (auto slot : changed) {
+                batch.markSent(slot, values[slot]);
+                updates.push_back({slot, values[slot]});
+            }
+        }
+
+        std::vector<float> values;
+        ParameterUpdateBatch batch;
+        std::vector<std::pair<size_t, float>> updates;
+        int snapshots {0};
+    };
+}
+
+TEST_CASE("Parameter updates are coalesced per frame", "[parameters][frame]") {
+    SECTION("Many sets before a frame send one update with the latest value") {
+        FakeParameters params(64);
+        for (int i = 1; i <= 100; i++) params.set(3, static_cast<float>(i) / 100.f);
+        params.frame();
+        REQUIRE(params.updates.size() == 1);
+        REQUIRE(params.updates[0].first == 3);
+        REQUIRE(params.updates[0].second == 1.f);
+        REQUIRE(params.snapshots == 0);
+
+        params.frame();
+        REQUIRE(params.updates.size() == 1);
+    }
+
+    SECTION("Writes that leave the value where it was send nothing") {
+        FakeParameters params(64);
+        params.set(5, 0.5f);
+        params.frame();
+        params.set(5, 0.5f);
+        params.set(5, 0.2f);
+        params.set(5, 0.5f);
+        params.frame();
+        REQUIRE(params.updates.size() == 1);
+    }
+
+    SECTION("The first value is always sent") {
+        FakeParameters params(64);
+        params.set(0, 0.f);
+        params.frame();
+        REQUIRE(params.updates.size() == 1);
+    }
+
+    SECTION("clearDirty drops pending changes") {
+        FakeParameters params(64);
+        params.set(1, 0.7f);
+        params.batch.clearDirty();
+        params.frame();
+        REQUIRE(params.updates.empty());
+    }
+}
+
+TEST_CASE("Enough changes in one frame switch to a snapshot", "[parameters][snapshot]") {
+    SECTION("Threshold is max(8, n / 8)") {
+        REQUIRE(ParameterUpdateBatch::getSnapshotThreshold(0) == 8);
+        REQUIRE(ParameterUpdateBatch::getSnapshotThreshold(64) == 8);
+        REQUIRE(ParameterUpdateBatch::getSnapshotThreshold(72) == 9);
+        REQUIRE(ParameterUpdateBatch::getSnapshotThreshold(800) == 100);
+    }
+
+    SECTION("One below the threshold sends single updates") {
+        FakeParameters params(800);
+        for (size_t i = 0; i < 99; i++) params.set(i, 1.f);
+        params.frame();
+        REQUIRE(params.updates.size() == 99);
+        REQUIRE(params.snapshots == 0);
+    }
+
+    SECTION("At the threshold one snapshot replaces them") {
+        FakeParameters params(800);
+        for (size_t i = 0; i < 100; i++) params.set(i, 1.f);
+        params.frame();
+        REQUIRE(params.updates.empty());
+        REQUIRE(params.snapshots == 1);
+
+        // the snapshot counts as sent, so nothing is repeated
+        for (size_t i = 0; i < 100; i++) params.set(i, 1.f);
+        params.frame();
+        REQUIRE(params.updates.empty());
+        REQUIRE(params.snapshots == 1);
+    }
+
+    SECTION("Small plugins use the floor of 8") {
+        FakeParameters params(16);
+        for (size_t i = 0; i < 7; i++) params.set(i, 1.f);
+        params.frame();
+        REQUIRE(params.snapshots == 0);
+
+        for (size_t i = 0; i < 8; i++) params.set(i, 0.5f);
+        params.frame();
+        REQUIRE(params.snapshots == 1);
+    }
+}
@@ -1,5 +1,6 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_string.hpp>
+#include <limits>
 #include <juce_audio_utils/juce_audio_utils.h>
 #include "../src/attachment/PresetAttachment.h"
 #include "imagiro_processor/processor/Processor.h"
@@ -281,3 +282,179 @@ TEST_CASE("Preset deletion", "[preset][attachment][delete]") {
         REQUIRE_FALSE(presetFile.existsAsFile());
     }
 }
+
+TEST_CASE("Preset index only reparses changed files", "[preset][index]") {
+    TestProcessor processor;
+
+    auto tempDir = juce::File::getSpecialLocation(juce::File::tempDirectory)
+        .getChildFile("preset_index_test_" + juce::Uuid().toString());
+    tempDir.createDirectory();
+    TempFileCleanup cleanup(tempDir);
+
+    auto presetsDir = tempDir.getChildFile("Presets");
+    auto cacheFile = tempDir.getChildFile("presetIndex.json");
+    presetsDir.getChildFile("Bass").createDirectory();
+
+    auto presetFile = presetsDir.getChildFile("Bass/Sub.json");
+    processor.savePreset({"Sub", "Deep"}).saveToFile(presetFile.getFullPathName().toStdString());
+
+    PresetIndex index(presetsDir, cacheFile);
+
+    SECTION("Picks up new files and ignores unchanged ones") {
+        REQUIRE(index.refresh());
+        REQUIRE(index.getEntries().size() == 1);
+        REQUIRE(index.getEntries().begin()->second.category == "Bass");
+        REQUIRE(index.getEntries().begin()->second.name == "Sub");
+
+        REQUIRE_FALSE(index.refresh());
+    }
+
+    SECTION("Reparses a file when it changes") {
+        index.refresh();
+
+        processor.savePreset({"Sub 2", "Deeper"}).saveToFile(presetFile.getFullPathName().toStdString());
+        presetFile.setLastModificationTime(juce::Time::getCurrentTime() + juce::RelativeTime::seconds(10));
+
+        REQUIRE(index.refreshFile(presetFile));
+        REQUIRE(index.getEntries().begin()->second.name == "Sub 2");
+    }
+
+    SECTION("Drops entries for deleted files") {
+        index.refresh();
+        presetFile.deleteFile();
+
+        REQUIRE(index.refresh());
+        REQUIRE(index.getEntries().empty());
+    }
+
+    SECTION("Saved index is reused without reparsing") {
+        index.refresh();
+        index.save();
+
+        PresetIndex reloaded(presetsDir, cacheFile);
+        reloaded.load();
+        REQUIRE(reloaded.getEntries().size() == 1);
+        REQUIRE_FALSE(reloaded.refresh());
+    }
+}
+
+TEST_CASE("Parsed preset cache checks the file on disk", "[preset][cache]") {
+    TestProcessor processor;
+
+    auto tempDir = juce::File::getSpecialLocation(juce::File::tempDirectory)
+        .getChildFile("parsed_preset_cache_test_" + juce::Uuid().toString());
+    tempDir.createDirectory();
+    TempFileCleanup cleanup(tempDir);
+
+    auto presetFile = tempDir.getChildFile("Lead.json");
+    processor.savePreset({"Lead", "Bright"}).saveToFile(presetFile.getFullPathName().toStdString());
+
+    ParsedPresetCache cache;
+    auto signature = ParsedPresetCache::getSignature(presetFile);
+    REQUIRE(signature.has_value());
+    cache.put("Lead.json", *signature, std::make_shared<const Preset>(processor.savePreset({"Lead", "Bright"})));
+
+    SECTION("Hits while the file is unchanged") {
+        REQUIRE(cache.contains("Lead.json", presetFile));
+        REQUIRE(cache.get("Lead.json", presetFile) != nullptr);
+    }
+
+    SECTION("Misses once the file is edited behind its back") {
+        processor.savePreset({"Lead 2", "Brighter and longer"}).saveToFile(presetFile.getFullPathName().toStdString());
+        presetFile.setLastModificationTime(juce::Time::getCurrentTime() + juce::RelativeTime::seconds(10));
+
+        REQUIRE_FALSE(cache.contains("Lead.json", presetFile));
+        REQUIRE(cache.get("Lead.json", presetFile) == nullptr);
+    }
+
+    SECTION("Misses once the file is deleted") {
+        presetFile.deleteFile();
+        REQUIRE(cache.get("Lead.json", presetFile) == nullptr);
+    }
+}
+
+TEST_CASE("Preset search index", "[preset][search]") {
+    PresetSearchIndex index;
+    index.build({
+        {"Warm Bass", "Bass", "Round sub with a little drive", false},
+        {"Glass Pad", "Pads", "Shimmering and wide", true},
+        {"Basement Keys", "Keys", "Dusty electric piano", false},
+    });
+
+    SECTION("Empty query returns everything in order") {
+        auto hits = index.search("");
+        REQUIRE(hits.size() == 3);
+        REQUIRE(hits[0].document == 0);
+    }
+
+    SECTION("Matches prefixes and ranks exact name matches first") {
+        auto hits = index.search("bas");
+        REQUIRE(hits.size() == 2);
+
+        hits = index.search("bass");
+        REQUIRE_FALSE(hits.empty());
+        REQUIRE(hits[0].document == 0);
+    }
+
+    SECTION("Tolerates typos") {
+        auto hits = index.search("shimering");
+        REQUIRE(hits.size() == 1);
+        REQUIRE(hits[0].document == 1);
+    }
+
+    SECTION("Requires every query token to match") {
+        REQUIRE(index.search("warm pad").empty());
+        REQUIRE(index.search("electric keys").size() == 1);
+    }
+
+    SECTION("Can restrict to favorites") {
+        auto hits = index.search("", true);
+        REQUIRE(hits.size() == 1);
+        REQUIRE(hits[0].document == 1);
+    }
+}
+
+TEST_CASE("Preset search handles UTF-8 names", "[preset][search]") {
+    PresetSearchIndex index;
+    index.build({
+        {"Caf\xc3\xa9 Keys", "Keys", "", false},
+        {"\xe6\x9f\x94\xe3\x82\x89\xe3\x81\x8b Pad", "Pads", "", false},
+        {"Cafe Organ", "Keys", "", false},
+    });
+
+    SECTION("Non-ASCII bytes stay inside their token") {
+        auto tokens = PresetSearchIndex::tokenize("Caf\xc3\xa9 Keys");
+        REQUIRE(tokens.size() == 2);
+        REQUIRE(tokens[0] == "caf\xc3\xa9");
+    }
+
+    SECTION("Finds names by their non-ASCII words") {
+        auto hits = index.search("caf\xc3\xa9");
+        REQUIRE(hits.size() == 1);
+        REQUIRE(hits[0].document == 0);
+
+        hits = index.search("\xe6\x9f\x94\xe3\x82\x89\xe3\x81\x8b");
+        REQUIRE(hits.size() == 1);
+        REQUIRE(hits[0].document == 1);
+    }
+}
+
+TEST_CASE("Preset pages are clamped to the list", "[preset][page]") {
+    constexpr auto maxInt64 = std::numeric_limits<int64_t>::max();
+
+    REQUIRE(PresetAttachment::getPageEnd(10, 0, 4) == 4);
+    REQUIRE(PresetAttachment::getPageEnd(10, 8, 4) == 10);
+    REQUIRE(PresetAttachment::getPageEnd(10, 3, 0) == 3);
+    REQUIRE(PresetAttachment::getPageEnd(10, -5, 2) == 2);
+
+    SECTION("Offsets past the end give an empty page") {
+        REQUIRE(PresetAttachment::getPageEnd(10, 10, 5) == 10);
+        REQUIRE(PresetAttachment::getPageEnd(10, maxInt64, 5) == 10);
+        REQUIRE(PresetAttachment::getPageEnd(0, 0, 5) == 0);
+    }
+
+    SECTION("offset + count can't overflow") {
+        REQUIRE(PresetAttachment::getPageEnd(10, 5, maxInt64) == 10);
+        REQUIRE(PresetAttachment::getPageEnd(10, maxInt64 - 1, maxInt64) == 10);
+    }
+}